@@ -24,9 +24,11 @@ extern "C" {
 #include <3ds/os.h>
 #include <3ds/synchronization.h>
 #include <3ds/thread.h>
+#include <3ds/jobs.h>
 #include <3ds/gfx.h>
 #include <3ds/console.h>
 #include <3ds/env.h>
+#include <3ds/util/compress.h>
 #include <3ds/util/decompress.h>
 #include <3ds/util/utf.h>
 
@@ -99,6 +101,7 @@ extern "C" {
 
 #include <3ds/archive.h>
 #include <3ds/romfs.h>
+#include <3ds/fs_async.h>
 #include <3ds/font.h>
 #include <3ds/mii.h>
 
@@ -6,6 +6,17 @@
 
 #include <stddef.h>
 
+/// Handle to a relocatable linear memory buffer.
+typedef struct LinearHandle_tag* LinearHandle;
+
+/// Linear heap thread cache statistics.
+typedef struct
+{
+	u32 hits;        ///< Number of allocations served from a thread cache.
+	u32 misses;      ///< Number of cacheable allocations that had to refill a thread cache from the linear heap.
+	u32 bytesCached; ///< Number of bytes currently held by all thread caches.
+} LinearCacheStats;
+
 /**
  * @brief Allocates a 0x80-byte aligned buffer.
  * @param size Size of the buffer to allocate.
@@ -47,3 +58,77 @@ void linearFree(void* mem);
  * @return The current linear free space.
  */
 u32 linearSpaceFree(void);
+
+/**
+ * @brief Enables or disables the per-thread linear heap caches.
+ * @param enable Whether to enable the caches.
+ *
+ * While enabled, small allocations (up to 0x1000 bytes, with at most 0x80-byte alignment)
+ * are served from a cache owned by the calling thread, and freed buffers of those sizes are
+ * kept in the cache of the freeing thread instead of being returned to the linear heap.
+ * Caches exchange buffers with the linear heap in batches.
+ * Disabling the caches returns the buffers held by every thread's cache to the linear heap.
+ *
+ * @note Buffers held in thread caches are not reported by @ref linearSpaceFree.
+ */
+void linearCacheSetEnabled(bool enable);
+
+/**
+ * @brief Returns all buffers held in the calling thread's linear heap cache to the linear heap.
+ * @note This is automatically called by @ref threadExit.
+ */
+void linearCacheFlush(void);
+
+/**
+ * @brief Retrieves the linear heap thread cache statistics.
+ * @param out Pointer to write the statistics to.
+ */
+void linearCacheGetStats(LinearCacheStats* out);
+
+/**
+ * @brief Allocates a relocatable buffer aligned to the given size.
+ * @param size Size of the buffer to allocate.
+ * @param alignment Alignment to use.
+ * @return A handle to the allocated buffer, or NULL on failure.
+ *
+ * Unlike regular linear buffers, relocatable buffers can be moved around by @ref linearCompact
+ * while they are not locked. Use @ref linearHandleLock to access the contents of the buffer.
+ */
+LinearHandle linearHandleAlloc(size_t size, size_t alignment);
+
+/**
+ * @brief Locks a relocatable buffer in place and retrieves its address.
+ * @param handle Handle to the buffer.
+ * @return The current address of the buffer, which stays valid until the matching @ref linearHandleUnlock.
+ * @note Locks are counted, every call needs to be matched by a call to @ref linearHandleUnlock.
+ */
+void* linearHandleLock(LinearHandle handle);
+
+/**
+ * @brief Unlocks a relocatable buffer, allowing it to be moved again.
+ * @param handle Handle to the buffer.
+ */
+void linearHandleUnlock(LinearHandle handle);
+
+/**
+ * @brief Retrieves the allocated size of a relocatable buffer.
+ * @param handle Handle to the buffer.
+ * @return The size of the buffer.
+ */
+size_t linearHandleGetSize(LinearHandle handle);
+
+/**
+ * @brief Frees a relocatable buffer.
+ * @param handle Handle to the buffer.
+ */
+void linearHandleFree(LinearHandle handle);
+
+/**
+ * @brief Compacts the linear heap by moving unlocked relocatable buffers towards lower addresses.
+ * @return The size of the largest free block of linear memory after compaction.
+ *
+ * Buffers returned by @ref linearAlloc/@ref linearMemAlign and locked relocatable buffers are never moved.
+ * Moved buffers are copied by the CPU, so their contents need to be flushed from the data cache
+ * (see @ref GSPGPU_FlushDataCache) before the GPU or other hardware accesses them.
+ */
+u32 linearCompact(void);
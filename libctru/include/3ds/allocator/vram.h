@@ -11,6 +11,23 @@ typedef enum vramAllocPos
 	VRAM_ALLOC_ANY = VRAM_ALLOC_A | VRAM_ALLOC_B,
 } vramAllocPos;
 
+/// VRAM placement policies, deciding which free block an allocation is carved out of.
+typedef enum vramPlacementPolicy
+{
+	VRAM_PLACE_GOOD_FIT   = 0, ///< Segregated good fit in constant time (default).
+	VRAM_PLACE_FIRST_FIT  = 1, ///< Lowest-addressed free block that fits.
+	VRAM_PLACE_BEST_FIT   = 2, ///< Smallest free block that fits.
+	VRAM_PLACE_SEGREGATED = 3, ///< Big allocations at the top of a bank, small ones at the bottom (see \ref vramSetSegregationThreshold).
+} vramPlacementPolicy;
+
+/// VRAM fragmentation information.
+typedef struct
+{
+	u32 freeSpace;   ///< Total free space.
+	u32 largestFree; ///< Size of the largest free block, i.e. the largest allocation that can currently succeed (before alignment).
+	u32 freeExtents; ///< Number of free blocks.
+} vramFragmentationInfo;
+
 /**
  * @brief Allocates a 0x80-byte aligned buffer.
  * @param size Size of the buffer to allocate.
@@ -69,3 +86,22 @@ void vramFree(void* mem);
  * @return The current VRAM free space.
  */
 u32 vramSpaceFree(void);
+
+/**
+ * @brief Sets the placement policy used by subsequent VRAM allocations.
+ * @param policy Placement policy to use (see \ref vramPlacementPolicy).
+ */
+void vramSetPlacementPolicy(vramPlacementPolicy policy);
+
+/**
+ * @brief Sets the size from which allocations count as big for \ref VRAM_PLACE_SEGREGATED.
+ * @param size Minimum size of big allocations (defaults to 0x10000 bytes).
+ */
+void vramSetSegregationThreshold(u32 size);
+
+/**
+ * @brief Retrieves fragmentation information about the given VRAM banks.
+ * @param pos VRAM banks to inspect (see \ref vramAllocPos).
+ * @param out Pointer to write the information to.
+ */
+void vramGetFragmentationInfo(vramAllocPos pos, vramFragmentationInfo* out);
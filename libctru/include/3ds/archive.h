@@ -5,6 +5,7 @@
 #pragma once
 
 #include <sys/types.h>
+#include <sys/dirent.h>
 
 #include <3ds/types.h>
 #include <3ds/services/fs.h>
@@ -21,6 +22,14 @@ typedef struct
   FS_DirectoryEntry entry_data[32]; /*! Temporary storage for reading entries */
 } archive_dir_t;
 
+/*! Directory entry returned by archiveDirRead */
+typedef struct
+{
+  const char *name;      /*! UTF-8 name, stored in the caller's name buffer */
+  u32        attributes; /*! FS attributes (FS_ATTRIBUTE_*) */
+  u64        size;       /*! File size */
+} archive_dirent_t;
+
 /// Mounts the SD
 Result archiveMountSdmc(void);
 
@@ -39,5 +48,31 @@ Result archiveUnmount(const char *deviceName);
 /// Unmounts all devices and cleans up any resources used by the driver
 Result archiveUnmountAll(void);
 
+/// Reads up to count entries of a directory opened with opendir() on an archive device, starting where readdir() left off.
+/// Names are converted to UTF-8 and packed, NUL-terminated, into namebuf. Each batch of up to 32 entries takes a single FS call.
+/// Returns the number of entries read (0 at the end of the directory), or -1 with errno set
+ssize_t archiveDirRead(DIR *dirp, archive_dirent_t *entries, size_t count, char *namebuf, size_t namebuf_size);
+
 /// Get a file's mtime
 Result archive_getmtime(const char *name, u64 *mtime);
+
+/// Block cache statistics
+typedef struct
+{
+  u32 requests;  ///< Reads that went through the cache
+  u32 hits;      ///< Blocks served from the cache
+  u32 misses;    ///< Blocks that had to be fetched from the FS
+  u32 readAhead; ///< Blocks fetched ahead of a sequential reader
+  u32 fsReads;   ///< FSFILE_Read calls issued on behalf of cached reads
+  u32 ipcsSaved; ///< FSFILE_Read calls avoided compared to uncached reads
+} archiveCacheStats;
+
+/// Sets up the LRU block cache shared by file reads on archive and RomFS devices.
+/// blockSize must be a power of two no smaller than 0x200; a blockCount of 0 disables the cache (the default).
+/// Sequential readers get an adaptive read-ahead window of up to a quarter of the cache, and reads spanning
+/// that many blocks bypass it. Cached blocks are dropped when the same file handle is written to, truncated or
+/// closed, but not on writes made through other handles to the same file.
+Result archiveCacheSetup(u32 blockSize, u32 blockCount);
+
+/// Retrieves block cache statistics; the hit rate is hits / (hits + misses)
+void archiveCacheGetStats(archiveCacheStats *out);
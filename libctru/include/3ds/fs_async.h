@@ -0,0 +1,83 @@
+/**
+ * @file fs_async.h
+ * @brief Asynchronous file reads.
+ */
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/synchronization.h>
+
+/// Maximum number of worker threads.
+#define FS_ASYNC_MAX_WORKERS 4
+
+struct fsAsyncRequest;
+
+/// Asynchronous read completion callback. Runs on a worker thread.
+typedef void (*fsAsyncCallback)(struct fsAsyncRequest* req);
+
+/// Asynchronous read request. The request must stay valid (and must not be modified) until it completes.
+typedef struct fsAsyncRequest
+{
+	Handle fd;                    ///< FS file handle to read from.
+	u64 offset;                   ///< Offset to read from.
+	void* buffer;                 ///< Buffer to read into.
+	u32 size;                     ///< Number of bytes to read.
+	fsAsyncCallback callback;     ///< Function to call on completion (optional).
+	void* user;                   ///< User data for the callback.
+	LightEvent* event;            ///< Event to signal once the callback returns, just before the request is marked as done (optional).
+	Result result;                ///< Result of the read, valid once the request completes.
+	u32 bytesRead;                ///< Number of bytes read, valid once the request completes.
+	struct fsAsyncRequest* next;  ///< Internal use only.
+	s32 state;                    ///< Internal use only.
+} fsAsyncRequest;
+
+/**
+ * @brief Starts the asynchronous read worker threads.
+ * @param numWorkers Number of worker threads (1 to \ref FS_ASYNC_MAX_WORKERS).
+ * @param priority Priority of the worker threads, usually lower (numerically higher) than the main thread's.
+ * @param core_id Processor to run the worker threads on (see \ref threadCreate).
+ * @remark Workers merge queued requests that read adjacent ranges of the same file into a single FS read.
+ */
+Result fsAsyncInit(u32 numWorkers, int priority, int core_id);
+
+/// Completes every queued request, then stops the worker threads.
+void fsAsyncExit(void);
+
+/**
+ * @brief Queues a batch of read requests.
+ * @param reqs Requests to queue, with their fd, offset, buffer, size, callback, user and event fields set.
+ * @param count Number of requests.
+ */
+Result fsAsyncSubmit(fsAsyncRequest* reqs, u32 count);
+
+/**
+ * @brief Fills in and queues a single read request.
+ * @param req Request to use.
+ * @param fd FS file handle to read from.
+ * @param offset Offset to read from.
+ * @param buffer Buffer to read into.
+ * @param size Number of bytes to read.
+ * @param callback Function to call on completion (optional).
+ * @param user User data for the callback.
+ */
+Result fsAsyncRead(fsAsyncRequest* req, Handle fd, u64 offset, void* buffer, u32 size, fsAsyncCallback callback, void* user);
+
+/// Checks whether a request has completed.
+bool fsAsyncIsDone(const fsAsyncRequest* req);
+
+/**
+ * @brief Waits for a request to complete.
+ * @param req Request to wait for.
+ * @return The result of the read.
+ * @remark This waits on the request itself rather than on its event. A thread woken by an event (which several requests
+ *         can share) should call this to make sure the request is marked as done before reusing the request or the event.
+ */
+Result fsAsyncWait(fsAsyncRequest* req);
+
+/**
+ * @brief Waits for a batch of requests to complete.
+ * @param reqs Requests to wait for.
+ * @param count Number of requests.
+ * @return The result of the first failed read, or 0 if all of them succeeded.
+ */
+Result fsAsyncWaitAll(fsAsyncRequest* reqs, u32 count);
@@ -0,0 +1,99 @@
+/**
+ * @file jobs.h
+ * @brief Work-stealing job system.
+ */
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/synchronization.h>
+
+/// Maximum number of worker threads, one per processor.
+#define JOBS_MAX_WORKERS 4
+
+/// Number of jobs each worker can have queued before new jobs run inline.
+#define JOBS_QUEUE_SIZE 256
+
+struct Job;
+
+/// Job function.
+typedef void (*JobFunc)(void* arg);
+
+/// Range function used by \ref ctruParallelFor, called for [begin, end).
+typedef void (*JobRangeFunc)(u32 begin, u32 end, void* arg);
+
+/// Counts the unfinished jobs of a group, to wait on them or make other jobs depend on them.
+typedef struct JobCounter
+{
+	s32 value;               ///< Number of unfinished jobs.
+	s32 wait;                ///< 0 while a thread waits for the counter to reach zero.
+	LightLock lock;          ///< Guards the last decrement and the dependent list.
+	struct Job* dependents;  ///< Jobs waiting for the counter to reach zero.
+} JobCounter;
+
+/// Job. The job must stay valid (and must not be modified) until it starts running.
+typedef struct Job
+{
+	JobFunc func;            ///< Function to run.
+	void* arg;               ///< Argument to pass to the function.
+	JobCounter* counter;     ///< Counter to decrement once the job finishes (optional).
+	JobCounter* dependency;  ///< Counter which must reach zero before the job may run (optional).
+	struct Job* next;        ///< Internal use only.
+} Job;
+
+/**
+ * @brief Starts the job worker threads.
+ * @param coreMask Processors to start a worker on, one bit per processor (see \ref threadCreate).
+ * @param priority Priority of the worker threads.
+ * @param stackSize Stack size of the worker threads.
+ * @remark Processors the application may not use are skipped, so 0xF starts a worker on every allowed processor.
+ *         The number of workers started can be retrieved with \ref jobsGetWorkerCount.
+ * @remark Each worker owns a deque of jobs and steals from the others once it runs out. Idle workers sleep
+ *         through address arbitration instead of polling.
+ */
+Result jobsInit(u32 coreMask, int priority, size_t stackSize);
+
+/// Runs every queued job, then stops the worker threads.
+void jobsExit(void);
+
+/// Gets the number of running worker threads.
+u32 jobsGetWorkerCount(void);
+
+/**
+ * @brief Initializes a job counter.
+ * @param counter Counter to initialize.
+ */
+void jobsCounterInit(JobCounter* counter);
+
+/**
+ * @brief Queues a batch of jobs.
+ * @param jobs Jobs to queue, with their func, arg, counter and dependency fields set.
+ * @param count Number of jobs.
+ * @remark Each job increments its counter right away. A job with a dependency is held back until the
+ *         dependency reaches zero; jobs must not be added to a counter once others depend on it reaching zero.
+ * @remark Jobs can be queued from any thread, including from other jobs. Without worker threads, or if the
+ *         queue is full, jobs run on the threads that wait for them.
+ */
+void jobsSubmit(Job* jobs, u32 count);
+
+/// Checks whether every job of a counter has finished.
+bool jobsIsDone(const JobCounter* counter);
+
+/**
+ * @brief Waits for every job of a counter to finish.
+ * @param counter Counter to wait on.
+ * @remark The calling thread runs queued jobs while it waits. Call this before reusing or freeing a counter,
+ *         even if \ref jobsIsDone already returned true.
+ */
+void jobsWait(JobCounter* counter);
+
+/**
+ * @brief Runs a function over a range of indices on the worker threads and the calling thread.
+ * @param begin First index.
+ * @param end One past the last index.
+ * @param grain Number of indices handed out at once, or 0 to pick one from the range and worker count.
+ * @param func Function to call on each chunk of indices.
+ * @param arg Argument to pass to the function.
+ * @remark Returns once the whole range has been processed. Chunks are claimed from a shared index, so
+ *         threads that finish early keep taking work from the rest of the range.
+ */
+void ctruParallelFor(u32 begin, u32 end, u32 grain, JobRangeFunc func, void* arg);
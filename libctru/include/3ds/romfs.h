@@ -46,6 +46,22 @@ typedef struct
 	u16 name[];   ///< Name. (UTF-16)
 } romfs_file;
 
+/// RomFS file data access modes.
+typedef enum
+{
+	ROMFS_DATA_STREAM  = 0, ///< File data is read from the RomFS image on every read (default).
+	ROMFS_DATA_PRELOAD = 1, ///< The whole file data region is loaded into memory up front.
+	ROMFS_DATA_LAZY    = 2, ///< Memory is reserved for the whole file data region, which is loaded in 64 KiB blocks on first access.
+} RomfsDataMode;
+
+/// RomFS path index modes.
+typedef enum
+{
+	ROMFS_INDEX_NONE  = 0, ///< Paths are resolved one component at a time (default).
+	ROMFS_INDEX_EAGER = 1, ///< A full path index is built right away.
+	ROMFS_INDEX_LAZY  = 2, ///< A full path index is built on the first lookup.
+} RomfsIndexMode;
+
 /**
  * @brief Mounts the Application's RomFS.
  * @param name Device mount name.
@@ -80,6 +96,53 @@ Result romfsMountFromTitle(u64 tid, FS_MediaType mediatype, const char* name);
 /// Unmounts the RomFS device.
 Result romfsUnmount(const char *name);
 
+/**
+ * @brief Sets how a mounted RomFS device accesses file data.
+ * @param name Device mount name.
+ * @param mode Data access mode (see \ref RomfsDataMode).
+ * @remark In \ref ROMFS_DATA_PRELOAD and \ref ROMFS_DATA_LAZY modes, reads are served with a memcpy instead of an FS IPC
+ *         and \ref romfsGetFilePointer can be used. Both modes need enough heap memory for the whole file data region.
+ * @note This must not be called while files of the device are being read.
+ */
+Result romfsSetDataMode(const char *name, RomfsDataMode mode);
+
+/**
+ * @brief Retrieves a pointer to the in-memory data of a RomFS file, without copying it.
+ * @param path Path of the file, including the device name (i.e. "romfs:/file.bin").
+ * @param ptr Pointer to output the read-only file data pointer to.
+ * @param size Pointer to output the file size to.
+ * @remark The device must be in \ref ROMFS_DATA_PRELOAD or \ref ROMFS_DATA_LAZY mode.
+ *         The pointer stays valid until the device is unmounted or its data mode is changed.
+ */
+Result romfsGetFilePointer(const char *path, const void **ptr, size_t *size);
+
+/**
+ * @brief Retrieves where the data of a RomFS file lives within the RomFS image, e.g. for use with \ref fsAsyncRead.
+ * @param path Path of the file, including the device name (i.e. "romfs:/file.bin").
+ * @param fd Pointer to output the FS file handle of the RomFS image to. It stays owned by the device.
+ * @param offset Pointer to output the offset of the file data within the image to.
+ * @param size Pointer to output the file size to.
+ */
+Result romfsGetFileLocation(const char *path, Handle *fd, u64 *offset, u64 *size);
+
+/**
+ * @brief Sets whether a mounted RomFS device resolves paths through a full path index.
+ * @param name Device mount name.
+ * @param mode Index mode (see \ref RomfsIndexMode).
+ * @remark The index maps whole paths to their entries with a single hash table lookup, instead of converting and hashing every
+ *         path component. It takes 8 bytes per file and directory, rounded up to a power of two at a load factor of at most 3/4.
+ *         Only absolute paths (and paths relative to the root directory) without "." and ".." components use it.
+ * @note This must not be called while the device is in use.
+ */
+Result romfsSetPathIndex(const char *name, RomfsIndexMode mode);
+
+/**
+ * @brief Gets the memory used by the path index of a mounted RomFS device.
+ * @param name Device mount name.
+ * @return Size of the index in bytes, or 0 if it is not built.
+ */
+size_t romfsGetPathIndexSize(const char *name);
+
 /// Wrapper for \ref romfsMountSelf with the default "romfs" device name.
 static inline Result romfsInit(void)
 {
@@ -30,6 +30,45 @@ typedef struct
 	s16 max_count;          ///< The maximum release count of the semaphore
 } LightSemaphore;
 
+/// Reader-writer lock policies.
+typedef enum
+{
+	RWLOCK_PREFER_READERS = 0, ///< Readers may take the lock while writers are waiting for it.
+	RWLOCK_PREFER_WRITERS = 1, ///< Waiting writers keep new readers out.
+} RWLockPolicy;
+
+/// A light barrier.
+typedef struct
+{
+	s32 remaining;   ///< Number of threads yet to arrive in the current phase
+	s32 count;       ///< Number of threads the barrier waits for
+	s32 sense;       ///< Current phase parity
+	s32 released[2]; ///< Release flag of each phase parity: 0=waiting, 1=released
+} LightBarrier;
+
+/// A light once-only initialization flag.
+typedef s32 LightOnce;
+
+/// Initial value of a light once-only initialization flag.
+#define LIGHTONCE_INIT 0
+
+/// Contention statistics of a light lock.
+typedef struct
+{
+	LightLock* lock;  ///< Pointer to the lock
+	u32 acquisitions; ///< Number of times the lock was taken
+	u32 contended;    ///< Number of times the lock was already held when taking it
+	u64 wait_ticks;   ///< System ticks spent waiting for the lock
+} LightLockStats;
+
+/// A light reader-writer lock.
+typedef struct
+{
+	s32 state;         ///< Lock state: bit 31=readers blocked, 30=write locked, 28=writer woken, 19-27=waiting writers, 10-18=waiting readers, 0-9=readers
+	s32 writer_tokens; ///< Number of wake-ups handed to waiting writers
+	u8 policy;         ///< Lock policy (see @ref RWLockPolicy)
+} LightRWLock;
+
 /// Performs a Data Synchronization Barrier operation.
 static inline void __dsb(void)
 {
@@ -201,6 +240,29 @@ int LightLock_TryLock(LightLock* lock);
  */
 void LightLock_Unlock(LightLock* lock);
 
+/**
+ * @brief Sets how long threads spin on a held light lock before sleeping.
+ * @param count Maximum number of spins, or zero to sleep right away (the default).
+ *
+ * Spinning pays off when critical sections are short and the lock holder runs on another core. The spin count adapts
+ * to how long recent spins took to get the lock, up to the maximum, and threads stop spinning once others are asleep
+ * waiting for the same lock.
+ */
+void LightLock_SetSpinCount(u32 count);
+
+/**
+ * @brief Gets the most contended light locks, when libctru is built with LIGHTLOCK_PROFILE defined (e.g. make LIBCTRU_CFLAGS=-DLIGHTLOCK_PROFILE).
+ * @param stats Array to write the statistics to, ordered by time spent waiting.
+ * @param max_stats Number of entries in the array.
+ * @return Number of entries written; always zero without LIGHTLOCK_PROFILE.
+ */
+u32 LightLock_GetTopContended(LightLockStats* stats, u32 max_stats);
+
+/**
+ * @brief Resets the contention statistics of every light lock.
+ */
+void LightLock_ResetStats(void);
+
 /**
  * @brief Initializes a recursive lock.
  * @param lock Pointer to the lock.
@@ -319,6 +381,25 @@ void LightEvent_Wait(LightEvent* event);
  */
 int LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns);
 
+/**
+ * @brief Waits on several light events until one of them is signaled.
+ * @param events Pointer to an array of events.
+ * @param count Number of events.
+ * @return Index of the signaled event. One-shot events are cleared as by @ref LightEvent_Wait; pulses are not seen.
+ *
+ * No kernel handles are involved: while any thread is waiting here, every signaled light event wakes it up to check.
+ */
+s32 LightEvent_WaitAny(LightEvent* const* events, s32 count);
+
+/**
+ * @brief Waits on several light events until one of them is signaled or the timeout is reached.
+ * @param events Pointer to an array of events.
+ * @param count Number of events.
+ * @param timeout_ns Timeout in nanoseconds.
+ * @return Index of the signaled event, or -1 on timeout.
+ */
+s32 LightEvent_WaitAnyTimeout(LightEvent* const* events, s32 count, s64 timeout_ns);
+
 /**
  * @brief Initializes a light semaphore.
  * @param event Pointer to the semaphore.
@@ -348,3 +429,90 @@ int LightSemaphore_TryAcquire(LightSemaphore* semaphore, s32 count);
  * @param count Release count
  */
 void LightSemaphore_Release(LightSemaphore* semaphore, s32 count);
+
+/**
+ * @brief Initializes a light barrier.
+ * @param barrier Pointer to the barrier.
+ * @param count Number of threads the barrier waits for.
+ */
+void LightBarrier_Init(LightBarrier* barrier, s32 count);
+
+/**
+ * @brief Waits on a light barrier until the given number of threads have reached it, then releases them all at once.
+ * @param barrier Pointer to the barrier.
+ * @return Non-zero for the last thread to arrive, zero for the others.
+ *
+ * The barrier resets itself, so the same threads can keep waiting on it phase after phase.
+ */
+int LightBarrier_Wait(LightBarrier* barrier);
+
+/**
+ * @brief Runs a function once per flag, no matter how many threads call this.
+ * @param once Pointer to the flag, set to @ref LIGHTONCE_INIT beforehand.
+ * @param func Function to run.
+ * @param arg Argument to pass to the function.
+ *
+ * Threads arriving while the function runs wait for it to finish. Once it has, this only costs a load and a barrier.
+ */
+void LightOnce_Call(LightOnce* once, void (*func)(void* arg), void* arg);
+
+/**
+ * @brief Initializes a light reader-writer lock.
+ * @param lock Pointer to the lock.
+ * @param policy Whether readers or waiting writers go first (RWLOCK_PREFER_READERS/RWLOCK_PREFER_WRITERS).
+ */
+void LightRWLock_Init(LightRWLock* lock, RWLockPolicy policy);
+
+/**
+ * @brief Locks a light reader-writer lock for reading, shared with other readers.
+ * @param lock Pointer to the lock.
+ */
+void LightRWLock_ReadLock(LightRWLock* lock);
+
+/**
+ * @brief Attempts to lock a light reader-writer lock for reading.
+ * @param lock Pointer to the lock.
+ * @return Zero on success, non-zero on failure.
+ */
+int LightRWLock_TryReadLock(LightRWLock* lock);
+
+/**
+ * @brief Locks a light reader-writer lock for reading with a timeout.
+ * @param lock Pointer to the lock.
+ * @param timeout_ns Timeout in nanoseconds.
+ * @return Zero on success, non-zero on timeout.
+ */
+int LightRWLock_ReadLockTimeout(LightRWLock* lock, s64 timeout_ns);
+
+/**
+ * @brief Unlocks a light reader-writer lock locked for reading.
+ * @param lock Pointer to the lock.
+ */
+void LightRWLock_ReadUnlock(LightRWLock* lock);
+
+/**
+ * @brief Locks a light reader-writer lock for writing, excluding every other thread.
+ * @param lock Pointer to the lock.
+ */
+void LightRWLock_WriteLock(LightRWLock* lock);
+
+/**
+ * @brief Attempts to lock a light reader-writer lock for writing.
+ * @param lock Pointer to the lock.
+ * @return Zero on success, non-zero on failure.
+ */
+int LightRWLock_TryWriteLock(LightRWLock* lock);
+
+/**
+ * @brief Locks a light reader-writer lock for writing with a timeout.
+ * @param lock Pointer to the lock.
+ * @param timeout_ns Timeout in nanoseconds.
+ * @return Zero on success, non-zero on timeout.
+ */
+int LightRWLock_WriteLockTimeout(LightRWLock* lock, s64 timeout_ns);
+
+/**
+ * @brief Unlocks a light reader-writer lock locked for writing.
+ * @param lock Pointer to the lock.
+ */
+void LightRWLock_WriteUnlock(LightRWLock* lock);
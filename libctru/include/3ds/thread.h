@@ -96,6 +96,53 @@ Thread threadGetCurrent(void);
  */
 void threadExit(int rc) __attribute__((noreturn));
 
+/// libctru thread pool handle type
+typedef struct ThreadPool_tag* ThreadPool;
+
+/**
+ * @brief Creates a pool of parked threads that functions can be dispatched onto.
+ * @param num_threads Number of threads in the pool.
+ * @param stack_size The size of the stack of each thread (see @ref threadCreate).
+ * @param prio Priority of the threads (see @ref threadCreate).
+ * @param core_id The ID of the processor the threads should be ran on (see @ref threadCreate).
+ * @return The thread pool handle on success, NULL on failure.
+ *
+ * Every thread, along with its stack, TLS block and newlib state, is created up front and reused
+ * for each dispatched function, so dispatching skips the allocation and setup done by @ref threadCreate.
+ * Dispatched functions must return instead of calling @ref threadExit. Thread-local variables keep
+ * the values left by earlier functions run on the same thread.
+ */
+ThreadPool threadPoolCreate(u32 num_threads, size_t stack_size, int prio, int core_id);
+
+/**
+ * @brief Runs a function on a parked thread of a pool, waiting for one to become available if needed.
+ * @param pool Thread pool handle
+ * @param entrypoint The function to run
+ * @param arg The argument passed to @p entrypoint
+ */
+void threadPoolRun(ThreadPool pool, ThreadFunc entrypoint, void* arg);
+
+/**
+ * @brief Runs a function on a parked thread of a pool, if there is one.
+ * @param pool Thread pool handle
+ * @param entrypoint The function to run
+ * @param arg The argument passed to @p entrypoint
+ * @return Whether a parked thread was available.
+ */
+bool threadPoolTryRun(ThreadPool pool, ThreadFunc entrypoint, void* arg);
+
+/**
+ * @brief Waits for every function dispatched onto a pool to return.
+ * @param pool Thread pool handle
+ */
+void threadPoolWait(ThreadPool pool);
+
+/**
+ * @brief Waits for every dispatched function to return, then stops and frees the threads of a pool.
+ * @param pool Thread pool handle
+ */
+void threadPoolFree(ThreadPool pool);
+
 /**
  * @brief Sets the exception handler for the current thread. Called from the main thread, this sets the default handler.
  * @param handler The exception handler, necessarily an ARM function that does not return
@@ -0,0 +1,92 @@
+/**
+ * @file compress.h
+ * @brief Compression functions.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <3ds/util/decompress.h>
+
+#define COMPRESS_LEVEL_MIN     1 ///< Fastest compression level
+#define COMPRESS_LEVEL_DEFAULT 6 ///< Default compression level
+#define COMPRESS_LEVEL_MAX     9 ///< Best compression level
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** @brief Compress LZSS/LZ10
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress
+ *  @param[in]  insize  Data size
+ *  @param[in]  level   Compression level (COMPRESS_LEVEL_MIN to
+ *                      COMPRESS_LEVEL_MAX, 0 for COMPRESS_LEVEL_DEFAULT)
+ *  @returns Compressed size, including the header
+ *  @retval -1 error (including the output buffer being too small)
+ *
+ *  @note Matches are found with hash chains over the 4 KiB window; the level
+ *        sets how many candidates are checked and whether a longer match at
+ *        the next byte is looked for. Working memory is 32 KiB.
+ */
+ssize_t compress_LZSS(void *output, size_t outsize, const void *input,
+                      size_t insize, int level);
+
+/** @brief Compress LZ11
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress
+ *  @param[in]  insize  Data size
+ *  @param[in]  level   Compression level (see compress_LZSS())
+ *  @returns Compressed size, including the header
+ *  @retval -1 error (including the output buffer being too small)
+ */
+ssize_t compress_LZ11(void *output, size_t outsize, const void *input,
+                      size_t insize, int level);
+
+/** @brief Compress Huffman
+ *  @param[in]  bits    Data size in bits (1 to 8)
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress, one symbol per byte
+ *  @param[in]  insize  Data size
+ *  @returns Compressed size, including the header
+ *  @retval -1 error (including the output buffer being too small, or a byte
+ *             not fitting in @p bits)
+ */
+ssize_t compress_Huff(size_t bits, void *output, size_t outsize,
+                      const void *input, size_t insize);
+
+/** @brief Compress run-length encoding
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress
+ *  @param[in]  insize  Data size
+ *  @returns Compressed size, including the header
+ *  @retval -1 error (including the output buffer being too small)
+ */
+ssize_t compress_RLE(void *output, size_t outsize, const void *input,
+                     size_t insize);
+
+/** @brief Compress data into a chunked container (see decompressParallel())
+ *  @param[out] output    Output buffer
+ *  @param[in]  outsize   Output buffer size
+ *  @param[in]  input     Data to compress
+ *  @param[in]  insize    Data size
+ *  @param[in]  chunkSize Decompressed chunk size
+ *  @param[in]  type      Compression type for the chunks
+ *  @returns Compressed size
+ *  @retval -1 error (including the output buffer being too small)
+ *
+ *  @note Chunks are compressed at COMPRESS_LEVEL_DEFAULT. Chunks which would
+ *        not shrink are stored as DECOMPRESS_DUMMY.
+ */
+ssize_t compressChunked(void *output, size_t outsize, const void *input,
+                        size_t insize, size_t chunkSize, decompressType type);
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,6 +25,7 @@ typedef enum
   DECOMPRESS_HUFF8 = 0x28, ///< Huffman compression with 8-bit data
   DECOMPRESS_HUFF  = 0x28, ///< Huffman compression with 8-bit data
   DECOMPRESS_RLE   = 0x30, ///< Run-length encoding compression
+  DECOMPRESS_CHUNKED = 0x70, ///< Independently compressed chunks (see decompressParallel())
 } decompressType;
 
 /** @brief I/O vector */
@@ -38,6 +39,17 @@ typedef struct
 typedef ssize_t (*decompressCallback)(void *userdata, void *buffer,
                                       size_t size);
 
+/** @brief Streaming decompression status */
+typedef enum
+{
+  DECOMPRESS_STREAM_ERROR = -1, ///< Corrupt or unsupported data
+  DECOMPRESS_STREAM_MORE  =  0, ///< More input or output space is needed
+  DECOMPRESS_STREAM_END   =  1, ///< All data has been decompressed
+} decompressStreamStatus;
+
+/** @brief Streaming decompression state */
+typedef struct decompressStream decompressStream;
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -233,6 +245,84 @@ decompress_RLE(void *output, size_t size, decompressCallback callback,
   return decompressV_RLE(&iov, 1, callback, userdata, insize);
 }
 
+/** @brief Start streaming decompression
+ *  @returns Stream state, or NULL on allocation failure
+ *
+ *  @note The stream starts with the compression header, as read by
+ *        decompressHeader(). Only the back-reference window is buffered, so
+ *        neither the whole input nor the whole output needs to be in memory.
+ */
+decompressStream* decompressStreamInit(void);
+
+/** @brief Get the compression header of a stream
+ *  @param[in]  stream Stream state
+ *  @param[out] type   Decompression type
+ *  @param[out] size   Decompressed size
+ *  @returns Whether the header has been read yet
+ */
+bool decompressStreamGetHeader(const decompressStream *stream,
+                               decompressType *type, size_t *size);
+
+/** @brief Feed data to a stream
+ *  @param[in]  stream  Stream state
+ *  @param[in]  in      Input data
+ *  @param[in]  inLen   Input data size
+ *  @param[out] inUsed  Amount of input consumed
+ *  @param[out] out     Output buffer
+ *  @param[in]  outCap  Output buffer size
+ *  @param[out] outUsed Amount of output produced
+ *  @returns Stream status
+ *
+ *  @note Input may be split at any byte. Unconsumed input (only left over
+ *        when the output buffer fills up or the stream ends) must be fed
+ *        again in the next call.
+ */
+decompressStreamStatus decompressStreamFeed(decompressStream *stream,
+                                            const void *in, size_t inLen,
+                                            size_t *inUsed, void *out,
+                                            size_t outCap, size_t *outUsed);
+
+/** @brief Finish streaming decompression and free the stream state
+ *  @param[in] stream Stream state
+ *  @returns Whether all data was decompressed
+ */
+bool decompressStreamFinish(decompressStream *stream);
+
+/** @brief Decompress a chunked container using worker threads
+ *  @param[in] output     Output buffer
+ *  @param[in] size       Output size limit
+ *  @param[in] input      Container data
+ *  @param[in] insize     Container data size
+ *  @param[in] numWorkers Number of threads to decompress with, including the
+ *                        calling thread (at most 4)
+ *  @returns Whether succeeded
+ *
+ *  @note A chunked container starts with a DECOMPRESS_CHUNKED header,
+ *        followed by the decompressed chunk size (u32), the number of chunks
+ *        (u32) and the offset of each chunk plus the end of the last one
+ *        (u32 each, relative to the end of the index). Each chunk is an
+ *        ordinary compressed stream which decompresses to the chunk size
+ *        (less for the last chunk). Additional threads are created at the
+ *        priority of the calling thread, one per processor starting with
+ *        processor #1, falling back to the default processor.
+ */
+bool decompressParallel(void *output, size_t size, const void *input,
+                        size_t insize, unsigned int numWorkers);
+
+/** @brief Decompress the chunk of a chunked container holding an offset
+ *  @param[in]  output      Output buffer
+ *  @param[in]  outsize     Output buffer size
+ *  @param[in]  input       Container data
+ *  @param[in]  insize      Container data size
+ *  @param[in]  offset      Offset into the decompressed data
+ *  @param[out] chunkOffset Offset of the chunk into the decompressed data
+ *                          (optional)
+ *  @returns Size of the decompressed chunk
+ *  @retval -1 error
+ */
+ssize_t decompressChunkAt(void *output, size_t outsize, const void *input,
+                          size_t insize, size_t offset, size_t *chunkOffset);
+
 #ifdef __cplusplus
 }
 #endif
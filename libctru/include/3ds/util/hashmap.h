@@ -0,0 +1,157 @@
+/**
+ * @file hashmap.h
+ * @brief Hash tables.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/// Retrieves a hashmap item.
+#define hashmap_item(ptr, type, member) \
+  ((type*)(((char*)ptr) - offsetof(type, member)))
+
+typedef struct hashmap      hashmap_t;      ///< hashmap type.
+typedef struct hashmap_node hashmap_node_t; ///< hashmap node type.
+typedef struct hashmap_slot hashmap_slot_t; ///< hashmap slot type.
+
+typedef void     (*hashmap_node_destructor_t)(hashmap_node_t *node);       ///< hashmap node destructor.
+typedef uint32_t (*hashmap_node_hash_t)(const hashmap_node_t *node);       ///< hashmap node hash function.
+typedef int      (*hashmap_node_equal_t)(const hashmap_node_t *lhs,
+                                         const hashmap_node_t *rhs);       ///< hashmap node equality function.
+typedef int      (*hashmap_node_visitor_t)(hashmap_node_t *node,
+                                           void           *arg);           ///< hashmap node visitor.
+
+/// A hashmap node.
+struct hashmap_node
+{
+  uint32_t hash; ///< Cached hash.
+};
+
+/// A hashmap slot.
+struct hashmap_slot
+{
+  uint32_t       hash; ///< Hash of the node.
+  hashmap_node_t *node; ///< Node, or NULL if the slot is free.
+};
+
+/// A hashmap.
+struct hashmap
+{
+  hashmap_slot_t       *slots;     ///< Slots.
+  hashmap_slot_t       *old_slots; ///< Slots still being migrated after growing, or NULL.
+  hashmap_node_hash_t  hash;       ///< Node hash function.
+  hashmap_node_equal_t equal;      ///< Node equality function.
+  size_t               size;       ///< Size.
+  size_t               migrated;   ///< Number of old slots already migrated.
+  uint8_t              bits;       ///< Base 2 logarithm of the slot count, or 0 if there are no slots.
+  uint8_t              old_bits;   ///< Base 2 logarithm of the old slot count.
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes a hashmap.
+ * @param map Pointer to the map.
+ * @param hash Hash function to use.
+ * @param equal Equality function to use.
+ *
+ * Nodes are kept in an open-addressing table with Robin Hood probing. When the
+ * table grows, the old slots are moved over a few at a time by later inserts
+ * and removals instead of all at once, so no single operation pays for a full
+ * rehash. No memory is allocated until the first insertion.
+ */
+void
+hashmap_init(hashmap_t            *map,
+             hashmap_node_hash_t  hash,
+             hashmap_node_equal_t equal);
+
+/**
+ * @brief Gets whether a hashmap is empty
+ * @param map Pointer to the map.
+ * @return A non-zero value if the map is empty.
+ */
+int
+hashmap_empty(const hashmap_t *map);
+
+/**
+ * @brief Gets the size of a hashmap.
+ * @param map Pointer to the map.
+ */
+size_t
+hashmap_size(const hashmap_t *map);
+
+/**
+ * @brief Reserves room in a hashmap.
+ * @param map Pointer to the map.
+ * @param count Number of nodes to make room for.
+ * @return Whether succeeded.
+ *
+ * Unlike growing on insertion, this rehashes every node immediately.
+ */
+bool
+hashmap_reserve(hashmap_t *map,
+                size_t    count);
+
+/**
+ * @brief Inserts a node into a hashmap.
+ * @param map Pointer to the map.
+ * @param node Pointer to the node.
+ * @return The inserted node, the existing node with an equal key, or NULL if
+ *         the map could not grow.
+ */
+__attribute__((warn_unused_result))
+hashmap_node_t*
+hashmap_insert(hashmap_t      *map,
+               hashmap_node_t *node);
+
+/**
+ * @brief Finds a node within a hashmap.
+ * @param map Pointer to the map.
+ * @param node Pointer to the key node.
+ * @return The located node, or NULL.
+ */
+hashmap_node_t*
+hashmap_find(const hashmap_t      *map,
+             const hashmap_node_t *node);
+
+/**
+ * @brief Visits the nodes of a hashmap, in no particular order.
+ * @param map Pointer to the map.
+ * @param visitor Visitor to call; returning non-zero stops the iteration.
+ * @param arg Argument to pass to the visitor.
+ * @return The number of nodes visited.
+ *
+ * The visitor must not insert or remove nodes.
+ */
+size_t
+hashmap_foreach(const hashmap_t        *map,
+                hashmap_node_visitor_t visitor,
+                void                   *arg);
+
+/**
+ * @brief Removes a node from a hashmap.
+ * @param map Pointer to the map.
+ * @param node Pointer to the node, which must be in the map.
+ * @param destructor Destructor to use when removing the node.
+ */
+void
+hashmap_remove(hashmap_t                 *map,
+               hashmap_node_t            *node,
+               hashmap_node_destructor_t destructor);
+
+/**
+ * @brief Clears a hashmap and frees its slots.
+ * @param map Pointer to the map.
+ * @param destructor Destructor to use when clearing the map's nodes.
+ */
+void
+hashmap_clear(hashmap_t                 *map,
+              hashmap_node_destructor_t destructor);
+
+#ifdef __cplusplus
+}
+#endif
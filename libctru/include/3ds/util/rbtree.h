@@ -17,6 +17,9 @@ typedef struct rbtree_node rbtree_node_t; ///< rbtree node type.
 typedef void (*rbtree_node_destructor_t)(rbtree_node_t *Node);      ///< rbtree node destructor.
 typedef int  (*rbtree_node_comparator_t)(const rbtree_node_t *lhs,
                                          const rbtree_node_t *rhs); ///< rbtree node comparator.
+typedef void (*rbtree_node_augment_t)(rbtree_node_t *node);         ///< rbtree node aggregate updater.
+typedef int  (*rbtree_node_visitor_t)(rbtree_node_t *node,
+                                      void          *arg);          ///< rbtree node visitor.
 
 /// An rbtree node.
 struct rbtree_node
@@ -30,6 +33,7 @@ struct rbtree
 {
   rbtree_node_t            *root;      ///< Root node.
   rbtree_node_comparator_t comparator; ///< Node comparator.
+  rbtree_node_augment_t    augment;    ///< Node aggregate updater, or NULL.
   size_t                   size;       ///< Size.
 };
 
@@ -46,6 +50,22 @@ void
 rbtree_init(rbtree_t                 *tree,
             rbtree_node_comparator_t comparator);
 
+/**
+ * @brief Initializes an augmented rbtree.
+ * @param tree Pointer to the tree.
+ * @param comparator Comparator to use.
+ * @param augment Updater to use.
+ *
+ * The updater recomputes a node's subtree aggregate (e.g. the largest free
+ * block below it) from the node and its children. The tree calls it whenever
+ * a node's subtree changes, children before parents, so aggregates stay valid
+ * for O(log n) descents.
+ */
+void
+rbtree_init_augmented(rbtree_t                 *tree,
+                      rbtree_node_comparator_t comparator,
+                      rbtree_node_augment_t    augment);
+
 /**
  * @brief Gets whether an rbtree is empty
  * @param tree Pointer to the tree.
@@ -81,6 +101,45 @@ void
 rbtree_insert_multi(rbtree_t      *tree,
                     rbtree_node_t *node);
 
+/**
+ * @brief Inserts a node into an rbtree next to a hint.
+ * @param tree Pointer to the tree.
+ * @param hint Pointer to the node to insert after, or NULL.
+ * @param node Pointer to the node.
+ * @return The inserted node.
+ *
+ * When the node belongs right after the hint, it is linked there with at most
+ * two comparisons, e.g. when inserting increasing keys with the previous node
+ * as the hint. Otherwise this is the same as rbtree_insert().
+ */
+__attribute__((warn_unused_result))
+rbtree_node_t*
+rbtree_insert_hint(rbtree_t      *tree,
+                   rbtree_node_t *hint,
+                   rbtree_node_t *node);
+
+/**
+ * @brief Inserts multiple nodes into an rbtree next to a hint.
+ * @param tree Pointer to the tree.
+ * @param hint Pointer to the node to insert after, or NULL.
+ * @param node Pointer to the nodes.
+ */
+void
+rbtree_insert_multi_hint(rbtree_t      *tree,
+                         rbtree_node_t *hint,
+                         rbtree_node_t *node);
+
+/**
+ * @brief Builds an rbtree from sorted nodes in O(n).
+ * @param tree Pointer to the tree, which must be empty.
+ * @param nodes Pointer to the nodes, in ascending order.
+ * @param count Number of nodes.
+ */
+void
+rbtree_build(rbtree_t      *tree,
+             rbtree_node_t **nodes,
+             size_t        count);
+
 /**
  * @brief Finds a node within an rbtree.
  * @param tree Pointer to the tree.
@@ -91,6 +150,44 @@ rbtree_node_t*
 rbtree_find(const rbtree_t      *tree,
             const rbtree_node_t *node);
 
+/**
+ * @brief Finds the first node within an rbtree not less than a key.
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the key node.
+ * @return The located node, or NULL if every node is less.
+ */
+rbtree_node_t*
+rbtree_lower_bound(const rbtree_t      *tree,
+                   const rbtree_node_t *node);
+
+/**
+ * @brief Finds the first node within an rbtree greater than a key.
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the key node.
+ * @return The located node, or NULL if no node is greater.
+ */
+rbtree_node_t*
+rbtree_upper_bound(const rbtree_t      *tree,
+                   const rbtree_node_t *node);
+
+/**
+ * @brief Visits the nodes of an rbtree within a range, in order.
+ * @param tree Pointer to the tree.
+ * @param lo Pointer to the lowest key to visit, or NULL for no lower limit.
+ * @param hi Pointer to the highest key to visit, or NULL for no upper limit.
+ * @param visitor Visitor to call; returning non-zero stops the iteration.
+ * @param arg Argument to pass to the visitor.
+ * @return The number of nodes visited.
+ *
+ * The visitor must not remove nodes other than the one it is given.
+ */
+size_t
+rbtree_range(const rbtree_t        *tree,
+             const rbtree_node_t   *lo,
+             const rbtree_node_t   *hi,
+             rbtree_node_visitor_t visitor,
+             void                  *arg);
+
 /**
  * @brief Gets the minimum node of an rbtree.
  * @param tree Pointer to the tree.
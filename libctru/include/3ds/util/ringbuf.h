@@ -0,0 +1,206 @@
+/**
+ * @file ringbuf.h
+ * @brief Lock-free ring buffers.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/// Size of an MPSC ring buffer slot holding elements of the given size.
+#define RINGBUF_MPSC_SLOT_SIZE(elem_size) \
+  (sizeof(uint32_t) + (((elem_size) + 3) & ~(size_t)3))
+
+typedef struct ringbuf      ringbuf_t;      ///< Single-producer/single-consumer ring buffer type.
+typedef struct ringbuf_mpsc ringbuf_mpsc_t; ///< Multi-producer/single-consumer ring buffer type.
+
+/// A single-producer/single-consumer ring buffer.
+struct ringbuf
+{
+  uint32_t tail __attribute__((aligned(32))); ///< Read position, owned by the consumer.
+  uint32_t head_cache;                        ///< Write position last seen by the consumer.
+  int32_t  read_wait;                         ///< 0 while the consumer waits for data.
+
+  uint32_t head __attribute__((aligned(32))); ///< Write position, owned by the producer.
+  uint32_t tail_cache;                        ///< Read position last seen by the producer.
+  int32_t  write_wait;                        ///< 0 while the producer waits for room.
+
+  uint8_t  *data __attribute__((aligned(32))); ///< Element storage.
+  size_t   elem_size;                          ///< Element size.
+  uint32_t mask;                               ///< Capacity minus one.
+};
+
+/// A multi-producer/single-consumer ring buffer.
+struct ringbuf_mpsc
+{
+  uint32_t head __attribute__((aligned(32))); ///< Read position, owned by the consumer.
+  int32_t  read_wait;                         ///< 0 while the consumer waits for data.
+
+  int32_t  tail __attribute__((aligned(32))); ///< Write position, claimed by producers.
+  int32_t  write_wait;                        ///< 0 while producers wait for room.
+
+  uint8_t  *slots __attribute__((aligned(32))); ///< Slot storage.
+  size_t   elem_size;                           ///< Element size.
+  size_t   slot_size;                           ///< Slot size.
+  uint32_t mask;                                ///< Capacity minus one.
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes a single-producer/single-consumer ring buffer.
+ * @param rb Pointer to the ring buffer.
+ * @param buffer Storage for capacity * elem_size bytes.
+ * @param elem_size Element size.
+ * @param capacity Number of elements, which must be a power of two.
+ *
+ * One thread may write while another reads, without locks: every operation
+ * finishes in a bounded number of steps regardless of the other thread.
+ */
+void
+ringbuf_init(ringbuf_t *rb,
+             void      *buffer,
+             size_t    elem_size,
+             uint32_t  capacity);
+
+/**
+ * @brief Gets the number of elements a ring buffer can read.
+ * @param rb Pointer to the ring buffer.
+ *
+ * This is exact for the consumer and a lower bound for the producer.
+ */
+size_t
+ringbuf_readable(const ringbuf_t *rb);
+
+/**
+ * @brief Gets the number of elements a ring buffer can write.
+ * @param rb Pointer to the ring buffer.
+ *
+ * This is exact for the producer and a lower bound for the consumer.
+ */
+size_t
+ringbuf_writable(const ringbuf_t *rb);
+
+/**
+ * @brief Writes elements to a ring buffer, from the producer.
+ * @param rb Pointer to the ring buffer.
+ * @param src Elements to write.
+ * @param count Number of elements to write.
+ * @return The number of elements written, which is less than count if the
+ *         ring buffer fills up.
+ */
+size_t
+ringbuf_write(ringbuf_t  *rb,
+              const void *src,
+              size_t     count);
+
+/**
+ * @brief Reads elements from a ring buffer, from the consumer.
+ * @param rb Pointer to the ring buffer.
+ * @param dst Buffer to read elements into.
+ * @param count Number of elements to read.
+ * @return The number of elements read, which is less than count if the ring
+ *         buffer runs empty.
+ */
+size_t
+ringbuf_read(ringbuf_t *rb,
+             void      *dst,
+             size_t    count);
+
+/**
+ * @brief Waits until a ring buffer can read a number of elements, from the
+ *        consumer.
+ * @param rb Pointer to the ring buffer.
+ * @param count Number of elements to wait for, at most the capacity.
+ * @param timeout_ns Timeout in nanoseconds, or a negative value to wait
+ *        forever.
+ * @return Non-zero if the timeout expired.
+ */
+int
+ringbuf_wait_readable(ringbuf_t *rb,
+                      size_t    count,
+                      int64_t   timeout_ns);
+
+/**
+ * @brief Waits until a ring buffer can write a number of elements, from the
+ *        producer.
+ * @param rb Pointer to the ring buffer.
+ * @param count Number of elements to wait for, at most the capacity.
+ * @param timeout_ns Timeout in nanoseconds, or a negative value to wait
+ *        forever.
+ * @return Non-zero if the timeout expired.
+ */
+int
+ringbuf_wait_writable(ringbuf_t *rb,
+                      size_t    count,
+                      int64_t   timeout_ns);
+
+/**
+ * @brief Initializes a multi-producer/single-consumer ring buffer.
+ * @param rb Pointer to the ring buffer.
+ * @param buffer Storage for capacity * RINGBUF_MPSC_SLOT_SIZE(elem_size)
+ *        bytes, aligned to 4 bytes.
+ * @param elem_size Element size.
+ * @param capacity Number of elements, which must be a power of two.
+ *
+ * Any number of threads may push while one thread pops. Producers claim slots
+ * with ldrex/strex and never wait for each other to finish copying, but the
+ * consumer only sees elements in the order their slots were claimed.
+ */
+void
+ringbuf_mpsc_init(ringbuf_mpsc_t *rb,
+                  void           *buffer,
+                  size_t         elem_size,
+                  uint32_t       capacity);
+
+/**
+ * @brief Pushes an element to a ring buffer, from any producer.
+ * @param rb Pointer to the ring buffer.
+ * @param elem Element to push.
+ * @return Whether there was room for the element.
+ */
+bool
+ringbuf_mpsc_push(ringbuf_mpsc_t *rb,
+                  const void     *elem);
+
+/**
+ * @brief Pops an element from a ring buffer, from the consumer.
+ * @param rb Pointer to the ring buffer.
+ * @param elem Buffer to pop the element into.
+ * @return Whether an element was available.
+ */
+bool
+ringbuf_mpsc_pop(ringbuf_mpsc_t *rb,
+                 void           *elem);
+
+/**
+ * @brief Waits until a ring buffer has an element to pop, from the consumer.
+ * @param rb Pointer to the ring buffer.
+ * @param timeout_ns Timeout in nanoseconds, or a negative value to wait
+ *        forever.
+ * @return Non-zero if the timeout expired.
+ */
+int
+ringbuf_mpsc_wait_readable(ringbuf_mpsc_t *rb,
+                           int64_t        timeout_ns);
+
+/**
+ * @brief Waits until a ring buffer has room to push an element, from any
+ *        producer.
+ * @param rb Pointer to the ring buffer.
+ * @param timeout_ns Timeout in nanoseconds, or a negative value to wait
+ *        forever.
+ * @return Non-zero if the timeout expired.
+ *
+ * Another producer may still take the room before this one pushes.
+ */
+int
+ringbuf_mpsc_wait_writable(ringbuf_mpsc_t *rb,
+                           int64_t        timeout_ns);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,48 +1,94 @@
 #pragma once
+#include <stdlib.h>
 
-static rbtree_t sAddrMap;
-
-struct addrMapNode
+// Side table mapping the address of every live chunk to its block descriptor.
+// This is an open-addressing hash table (linear probing, Fibonacci hashing)
+// which only stores descriptor pointers, since the key is the block's base
+// address. The table only ever hits the heap when it needs to grow.
+struct AddrMap
 {
-	rbtree_node node;
-	MemChunk chunk;
-};
+	MemBlock** slots;
+	u32 count;
+	u8 bits;
 
-#define getAddrMapNode(x) rbtree_item((x), addrMapNode, node)
+	enum { MinBits = 6 };
 
-static int addrMapNodeComparator(const rbtree_node_t* _lhs, const rbtree_node_t* _rhs)
-{
-	auto lhs = getAddrMapNode(_lhs)->chunk.addr;
-	auto rhs = getAddrMapNode(_rhs)->chunk.addr;
-	if (lhs < rhs)
-		return -1;
-	if (lhs > rhs)
-		return 1;
-	return 0;
-}
-
-static void addrMapNodeDestructor(rbtree_node_t* a)
-{
-	free(getAddrMapNode(a));
-}
+	u32 Capacity() const { return bits ? 1U << bits : 0; }
 
-static addrMapNode* getNode(void* addr)
-{
-	addrMapNode n;
-	n.chunk.addr = (u8*)addr;
-	auto p = rbtree_find(&sAddrMap, &n.node);
-	return p ? getAddrMapNode(p) : nullptr;
-}
+	u32 Slot(const void* addr) const
+	{
+		return (((u32)addr >> MEMPOOL_ALIGN_SHIFT) * 0x9E3779B1U) >> (32 - bits);
+	}
 
-static addrMapNode* newNode(const MemChunk& chunk)
-{
-	auto p = (addrMapNode*)malloc(sizeof(addrMapNode));
-	if (!p) return nullptr;
-	p->chunk = chunk;
-	return p;
-}
+	MemBlock* Find(const void* addr) const
+	{
+		if (!count) return nullptr;
+		u32 mask = Capacity() - 1;
+		for (u32 i = Slot(addr);; i = (i + 1) & mask)
+		{
+			auto b = slots[i];
+			if (!b || b->base == addr)
+				return b;
+		}
+	}
 
-static void delNode(addrMapNode* node)
-{
-	rbtree_remove(&sAddrMap, &node->node, addrMapNodeDestructor);
-}
+	void Place(MemBlock* b)
+	{
+		u32 mask = Capacity() - 1;
+		u32 i = Slot(b->base);
+		while (slots[i])
+			i = (i + 1) & mask;
+		slots[i] = b;
+	}
+
+	bool Grow()
+	{
+		u8 newBits = bits ? bits + 1 : MinBits;
+		auto newSlots = (MemBlock**)calloc(1U << newBits, sizeof(MemBlock*));
+		if (!newSlots) return false;
+
+		auto oldSlots = slots;
+		u32 oldCapacity = Capacity();
+		slots = newSlots;
+		bits = newBits;
+		for (u32 i = 0; i < oldCapacity; i ++)
+			if (oldSlots[i])
+				Place(oldSlots[i]);
+		free(oldSlots);
+		return true;
+	}
+
+	bool Insert(MemBlock* b)
+	{
+		// Keep the load factor at or below 3/4
+		if ((count + 1) * 4 > Capacity() * 3 && !Grow())
+			return false;
+		Place(b);
+		count ++;
+		return true;
+	}
+
+	void Remove(MemBlock* b)
+	{
+		u32 mask = Capacity() - 1;
+		u32 i = Slot(b->base);
+		while (slots[i] != b)
+			i = (i + 1) & mask;
+
+		// Backward-shift deletion: pull later entries of the probe sequence
+		// into the hole so that lookups never need tombstones.
+		for (u32 j = (i + 1) & mask; slots[j]; j = (j + 1) & mask)
+		{
+			u32 home = Slot(slots[j]->base);
+			if (((j - home) & mask) >= ((j - i) & mask))
+			{
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		slots[i] = nullptr;
+		count --;
+	}
+};
+
+static AddrMap sAddrMap;
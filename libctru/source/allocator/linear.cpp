@@ -1,8 +1,8 @@
 extern "C"
 {
 	#include <3ds/types.h>
+	#include <3ds/synchronization.h>
 	#include <3ds/allocator/linear.h>
-	#include <3ds/util/rbtree.h>
 }
 
 #include "mem_pool.h"
@@ -12,26 +12,63 @@ extern u32 __ctru_linear_heap;
 extern u32 __ctru_linear_heap_size;
 
 static MemPool sLinearPool;
+static LightLock sLinearLock = 1;
+
+// Thread caches hold chunks of a few power-of-two size classes, all of which
+// are aligned to the default linearAlloc alignment.
+enum
+{
+	LINEAR_CACHE_MIN_SHIFT = 7, // 0x80 bytes
+	LINEAR_CACHE_MAX_SHIFT = 12, // 0x1000 bytes
+	LINEAR_CACHE_CLASSES   = LINEAR_CACHE_MAX_SHIFT - LINEAR_CACHE_MIN_SHIFT + 1,
+	LINEAR_CACHE_DEPTH     = 16, // Chunks held per size class
+	LINEAR_CACHE_BATCH     = LINEAR_CACHE_DEPTH / 2, // Chunks moved per trip to the global pool
+};
+
+struct LinearCacheBin
+{
+	u32 count;
+	MemBlock* blocks[LINEAR_CACHE_DEPTH];
+};
+
+struct LinearCache
+{
+	LightLock lock; // Taken by the owner around bin accesses, and by linearCacheSetEnabled to drain the bins
+	LinearCache* prev;
+	LinearCache* next;
+	LinearCacheBin bins[LINEAR_CACHE_CLASSES];
+};
+
+struct LinearHandle_tag
+{
+	MemBlock* block;
+	u32 lockCount;
+	int shift;
+};
+
+static bool sLinearCacheEnabled;
+static LinearCacheStats sLinearCacheStats;
+static __thread LinearCache* sThreadCache;
+
+// Every thread cache, so that disabling the caches can drain them all.
+// Lock order: sLinearCacheListLock, then LinearCache::lock, then sLinearLock.
+static LightLock sLinearCacheListLock = 1;
+static LinearCache* sLinearCacheList;
 
 static bool linearInit()
 {
-	auto blk = MemBlock::Create((u8*)__ctru_linear_heap, __ctru_linear_heap_size);
+	auto blk = sLinearPool.NewBlock((u8*)__ctru_linear_heap, __ctru_linear_heap_size);
 	if (blk)
 	{
 		sLinearPool.AddBlock(blk);
-		rbtree_init(&sAddrMap, addrMapNodeComparator);
 		return true;
 	}
 	return false;
 }
 
-void* linearMemAlign(size_t size, size_t alignment)
+// Must be called with sLinearLock held
+static MemBlock* linearAllocBlock(size_t size, int shift)
 {
-	// Convert alignment to shift
-	int shift = alignmentToShift(alignment);
-	if (shift < 0)
-		return nullptr;
-
 	// Initialize the pool if it is not ready
 	if (!sLinearPool.Ready() && !linearInit())
 		return nullptr;
@@ -41,14 +78,155 @@ void* linearMemAlign(size_t size, size_t alignment)
 	if (!sLinearPool.Allocate(chunk, size, shift))
 		return nullptr;
 
-	auto node = newNode(chunk);
-	if (!node)
+	if (!sAddrMap.Insert(chunk.block))
+	{
+		sLinearPool.Deallocate(chunk.block);
+		return nullptr;
+	}
+	return chunk.block;
+}
+
+// Must be called with sLinearLock held
+static void linearFreeBlock(MemBlock* blk)
+{
+	// Forget the chunk, then free it
+	sAddrMap.Remove(blk);
+	sLinearPool.Deallocate(blk);
+}
+
+static int linearCacheClass(size_t size)
+{
+	if (size <= (1U << LINEAR_CACHE_MIN_SHIFT))
+		return 0;
+	return 32 - __builtin_clz(size - 1) - LINEAR_CACHE_MIN_SHIFT;
+}
+
+static LinearCache* linearCacheGet()
+{
+	auto cache = sThreadCache;
+	if (!cache)
 	{
-		sLinearPool.Deallocate(chunk);
+		cache = (LinearCache*)calloc(1, sizeof(LinearCache));
+		if (!cache)
+			return nullptr;
+
+		LightLock_Init(&cache->lock);
+		LightLock_Lock(&sLinearCacheListLock);
+		cache->next = sLinearCacheList;
+		if (cache->next)
+			cache->next->prev = cache;
+		sLinearCacheList = cache;
+		LightLock_Unlock(&sLinearCacheListLock);
+		sThreadCache = cache;
+	}
+	return cache;
+}
+
+static void linearCacheRelease(LinearCacheBin& bin, u32 count)
+{
+	u32 bytes = 0;
+
+	LightLock_Lock(&sLinearLock);
+	while (count--)
+	{
+		auto blk = bin.blocks[--bin.count];
+		blk->isCached = false;
+		bytes += blk->size;
+		linearFreeBlock(blk);
+	}
+	LightLock_Unlock(&sLinearLock);
+
+	__atomic_sub_fetch(&sLinearCacheStats.bytesCached, bytes, __ATOMIC_RELAXED);
+}
+
+// Must be called with cache->lock held
+static void linearCacheDrain(LinearCache* cache)
+{
+	for (auto& bin : cache->bins)
+		if (bin.count)
+			linearCacheRelease(bin, bin.count);
+}
+
+// Must be called with cache->lock held
+static void* linearCacheAllocLocked(LinearCache* cache, size_t size)
+{
+	// The caches may have been disabled since the caller checked
+	if (!sLinearCacheEnabled)
+		return nullptr;
+
+	int cls = linearCacheClass(size);
+	auto& bin = cache->bins[cls];
+	if (bin.count)
+	{
+		auto blk = bin.blocks[--bin.count];
+		blk->isCached = false;
+		__atomic_add_fetch(&sLinearCacheStats.hits, 1, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&sLinearCacheStats.bytesCached, blk->size, __ATOMIC_RELAXED);
+		return blk->base;
+	}
+
+	// Refill the bin with a batch of chunks, handing out the last one
+	u32 clsSize = 1U << (cls + LINEAR_CACHE_MIN_SHIFT);
+	MemBlock* blk = nullptr;
+
+	LightLock_Lock(&sLinearLock);
+	for (u32 i = 0; i < LINEAR_CACHE_BATCH; i ++)
+	{
+		if (blk)
+		{
+			blk->isCached = true;
+			bin.blocks[bin.count++] = blk;
+		}
+		blk = linearAllocBlock(clsSize, LINEAR_CACHE_MIN_SHIFT);
+		if (!blk) break;
+	}
+	LightLock_Unlock(&sLinearLock);
+
+	__atomic_add_fetch(&sLinearCacheStats.misses, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&sLinearCacheStats.bytesCached, bin.count * clsSize, __ATOMIC_RELAXED);
+
+	if (!blk && bin.count)
+	{
+		// The pool ran dry halfway through, fall back to one of the cached chunks
+		blk = bin.blocks[--bin.count];
+		blk->isCached = false;
+		__atomic_sub_fetch(&sLinearCacheStats.bytesCached, clsSize, __ATOMIC_RELAXED);
+	}
+	return blk ? blk->base : nullptr;
+}
+
+static void* linearCacheAlloc(size_t size)
+{
+	auto cache = linearCacheGet();
+	if (!cache)
+		return nullptr;
+
+	LightLock_Lock(&cache->lock);
+	void* mem = linearCacheAllocLocked(cache, size);
+	LightLock_Unlock(&cache->lock);
+	return mem;
+}
+
+void* linearMemAlign(size_t size, size_t alignment)
+{
+	// Convert alignment to shift
+	int shift = alignmentToShift(alignment);
+	if (shift < 0)
 		return nullptr;
+
+	// Small chunks with at most the default alignment can come from the thread cache
+	if (sLinearCacheEnabled && shift <= LINEAR_CACHE_MIN_SHIFT && size <= (1U << LINEAR_CACHE_MAX_SHIFT))
+	{
+		void* mem = linearCacheAlloc(size);
+		if (mem)
+			return mem;
 	}
-	if (rbtree_insert(&sAddrMap, &node->node));
-	return chunk.addr;
+
+	LightLock_Lock(&sLinearLock);
+	auto blk = linearAllocBlock(size, shift);
+	LightLock_Unlock(&sLinearLock);
+
+	return blk ? blk->base : nullptr;
 }
 
 void* linearAlloc(size_t size)
@@ -64,23 +242,196 @@ void* linearRealloc(void* mem, size_t size)
 
 size_t linearGetSize(void* mem)
 {
-	auto node = getNode(mem);
-	return node ? node->chunk.size : 0;
+	LightLock_Lock(&sLinearLock);
+	auto blk = sAddrMap.Find(mem);
+	size_t size = blk && !blk->isCached ? blk->size : 0;
+	LightLock_Unlock(&sLinearLock);
+
+	return size;
 }
 
 void linearFree(void* mem)
 {
-	auto node = getNode(mem);
-	if (!node) return;
+	// Chunks matching one of the size classes go back into the thread cache
+	auto cache = sLinearCacheEnabled ? linearCacheGet() : nullptr;
+	if (cache)
+		LightLock_Lock(&cache->lock);
 
-	// Free the chunk
-	sLinearPool.Deallocate(node->chunk);
+	LightLock_Lock(&sLinearLock);
+	auto blk = sAddrMap.Find(mem);
+	if (!blk || blk->isCached)
+	{
+		LightLock_Unlock(&sLinearLock);
+		if (cache)
+			LightLock_Unlock(&cache->lock);
+		return;
+	}
 
-	// Free the node
-	delNode(node);
+	// Check again with the cache locked, as disabling the caches drains them under that lock
+	u32 size = blk->size;
+	bool cacheable = cache && sLinearCacheEnabled && !(size & (size - 1))
+		&& size >= (1U << LINEAR_CACHE_MIN_SHIFT) && size <= (1U << LINEAR_CACHE_MAX_SHIFT)
+		&& !((u32)blk->base & ((1U << LINEAR_CACHE_MIN_SHIFT) - 1));
+	if (cacheable)
+		blk->isCached = true;
+	else
+		linearFreeBlock(blk);
+	LightLock_Unlock(&sLinearLock);
+
+	if (!cacheable)
+	{
+		if (cache)
+			LightLock_Unlock(&cache->lock);
+		return;
+	}
+
+	// Make room by returning a batch of chunks to the global pool
+	auto& bin = cache->bins[linearCacheClass(size)];
+	if (bin.count == LINEAR_CACHE_DEPTH)
+		linearCacheRelease(bin, LINEAR_CACHE_BATCH);
+
+	bin.blocks[bin.count++] = blk;
+	__atomic_add_fetch(&sLinearCacheStats.bytesCached, size, __ATOMIC_RELAXED);
+	LightLock_Unlock(&cache->lock);
 }
 
 u32 linearSpaceFree()
 {
-	return sLinearPool.GetFreeSpace();
+	LightLock_Lock(&sLinearLock);
+	u32 size = sLinearPool.GetFreeSpace();
+	LightLock_Unlock(&sLinearLock);
+
+	return size;
+}
+
+void linearCacheSetEnabled(bool enable)
+{
+	sLinearCacheEnabled = enable;
+	if (enable)
+		return;
+
+	// Return the chunks held by every thread, not just the calling one
+	LightLock_Lock(&sLinearCacheListLock);
+	for (auto cache = sLinearCacheList; cache; cache = cache->next)
+	{
+		LightLock_Lock(&cache->lock);
+		linearCacheDrain(cache);
+		LightLock_Unlock(&cache->lock);
+	}
+	LightLock_Unlock(&sLinearCacheListLock);
+}
+
+void linearCacheFlush(void)
+{
+	auto cache = sThreadCache;
+	if (!cache)
+		return;
+
+	sThreadCache = nullptr;
+
+	// Once unlinked, no other thread can reach the cache
+	LightLock_Lock(&sLinearCacheListLock);
+	if (cache->prev)
+		cache->prev->next = cache->next;
+	else
+		sLinearCacheList = cache->next;
+	if (cache->next)
+		cache->next->prev = cache->prev;
+	LightLock_Unlock(&sLinearCacheListLock);
+
+	linearCacheDrain(cache);
+	free(cache);
+}
+
+void linearCacheGetStats(LinearCacheStats* out)
+{
+	out->hits        = __atomic_load_n(&sLinearCacheStats.hits, __ATOMIC_RELAXED);
+	out->misses      = __atomic_load_n(&sLinearCacheStats.misses, __ATOMIC_RELAXED);
+	out->bytesCached = __atomic_load_n(&sLinearCacheStats.bytesCached, __ATOMIC_RELAXED);
+}
+
+LinearHandle linearHandleAlloc(size_t size, size_t alignment)
+{
+	// Convert alignment to shift
+	int shift = alignmentToShift(alignment);
+	if (shift < 0)
+		return nullptr;
+
+	auto handle = (LinearHandle)malloc(sizeof(LinearHandle_tag));
+	if (!handle)
+		return nullptr;
+
+	// Relocatable chunks are owned by their handle and never enter the address map
+	MemChunk chunk;
+	bool didAlloc = false;
+	LightLock_Lock(&sLinearLock);
+	if (sLinearPool.Ready() || linearInit())
+		didAlloc = sLinearPool.Allocate(chunk, size, shift);
+	if (didAlloc)
+		chunk.block->owner = handle;
+	LightLock_Unlock(&sLinearLock);
+
+	if (!didAlloc)
+	{
+		free(handle);
+		return nullptr;
+	}
+
+	handle->block = chunk.block;
+	handle->lockCount = 0;
+	handle->shift = shift;
+	return handle;
+}
+
+void* linearHandleLock(LinearHandle handle)
+{
+	LightLock_Lock(&sLinearLock);
+	handle->lockCount ++;
+	void* mem = handle->block->base;
+	LightLock_Unlock(&sLinearLock);
+
+	return mem;
+}
+
+void linearHandleUnlock(LinearHandle handle)
+{
+	LightLock_Lock(&sLinearLock);
+	if (handle->lockCount)
+		handle->lockCount --;
+	LightLock_Unlock(&sLinearLock);
+}
+
+size_t linearHandleGetSize(LinearHandle handle)
+{
+	return handle->block->size;
+}
+
+void linearHandleFree(LinearHandle handle)
+{
+	if (!handle) return;
+
+	LightLock_Lock(&sLinearLock);
+	sLinearPool.Deallocate(handle->block);
+	LightLock_Unlock(&sLinearLock);
+
+	free(handle);
+}
+
+u32 linearCompact(void)
+{
+	LightLock_Lock(&sLinearLock);
+
+	// A single pass in address order is enough: every unlocked relocatable chunk
+	// slides down into the free space left behind by the chunks before it.
+	for (auto b = sLinearPool.first; b; b = b->next)
+	{
+		auto handle = (LinearHandle)b->owner;
+		if (handle && !handle->lockCount)
+			sLinearPool.SlideDown(b, handle->shift);
+	}
+
+	u32 largest = sLinearPool.GetLargestFree();
+	LightLock_Unlock(&sLinearLock);
+
+	return largest;
 }
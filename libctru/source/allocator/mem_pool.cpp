@@ -1,36 +1,126 @@
+#include <string.h>
 #include "mem_pool.h"
 
-/*
-// This method is currently unused
-void MemPool::CoalesceLeft(MemBlock* b)
+static inline u32 blockAlignWaste(const MemBlock* b, u32 alignMask)
+{
+	u32 begWaste = (u32)b->base & alignMask;
+	if (begWaste > 0) begWaste = alignMask + 1 - begWaste;
+	return begWaste;
+}
+
+static inline bool blockFits(const MemBlock* b, u32 size, u32 alignMask)
+{
+	u32 begWaste = blockAlignWaste(b, alignMask);
+	return begWaste <= b->size && (b->size - begWaste) >= size;
+}
+
+void MemPool::MapSize(u32 size, int& fl, int& sl)
 {
-	auto curPtr = b->base;
-	for (auto p = b->prev; p; p = p->prev)
+	if (size < (1U << MEMPOOL_FL_MIN_SHIFT))
 	{
-		if ((p->base + p->size) != curPtr) break;
-		curPtr = p->base;
-		p->size += b->size;
-		DelBlock(b);
-		b = p;
+		// Small sizes are binned linearly
+		fl = 0;
+		sl = size >> MEMPOOL_ALIGN_SHIFT;
+	} else
+	{
+		int msb = 31 - __builtin_clz(size);
+		fl = msb - MEMPOOL_FL_MIN_SHIFT + 1;
+		sl = (size >> (msb - MEMPOOL_SL_SHIFT)) & (MEMPOOL_SL_COUNT - 1);
 	}
 }
-*/
 
-void MemPool::CoalesceRight(MemBlock* b)
+MemBlock* MemPool::FindFree(int& fl, int& sl)
 {
-	auto curPtr = b->base + b->size;
-	auto next = b->next;
-	for (auto n = next; n; n = next)
+	// Look for a non-empty list in the same size range first...
+	u32 slMap = slBitmap[fl] & (~0U << sl);
+	if (!slMap)
+	{
+		// ...otherwise use the smallest non-empty larger size range
+		u32 flMap = flBitmap & (~0U << (fl + 1));
+		if (!flMap)
+			return nullptr;
+
+		fl = __builtin_ctz(flMap);
+		slMap = slBitmap[fl];
+	}
+
+	sl = __builtin_ctz(slMap);
+	return freeLists[fl][sl];
+}
+
+MemBlock* MemPool::FindFit(u32 size, u32 alignMask)
+{
+	// Every block in a list is at least as large as the list's lower bound, hence
+	// bins below the one containing the requested size can never satisfy it.
+	int fl, sl;
+	MapSize(size, fl, sl);
+
+	for (;;)
+	{
+		auto b = FindFree(fl, sl);
+		if (!b)
+			return nullptr;
+
+		for (; b; b = b->nextFree)
+			if (blockFits(b, size, alignMask))
+				return b;
+
+		// Move on to the next bin
+		if (++sl == MEMPOOL_SL_COUNT)
+		{
+			sl = 0;
+			if (++fl == MEMPOOL_FL_COUNT)
+				return nullptr;
+		}
+	}
+}
+
+void MemPool::InsertFree(MemBlock* b)
+{
+	int fl, sl;
+	MapSize(b->size, fl, sl);
+
+	auto head = freeLists[fl][sl];
+	b->isFree = true;
+	b->prevFree = nullptr;
+	b->nextFree = head;
+	if (head) head->prevFree = b;
+	freeLists[fl][sl] = b;
+
+	flBitmap |= BIT(fl);
+	slBitmap[fl] |= BIT(sl);
+	freeSpace += b->size;
+	freeBlocks ++;
+}
+
+void MemPool::RemoveFree(MemBlock* b)
+{
+	int fl, sl;
+	MapSize(b->size, fl, sl);
+
+	auto prev = b->prevFree, next = b->nextFree;
+	if (prev)
+		prev->nextFree = next;
+	else
 	{
-		next = n->next;
-		if (n->base != curPtr) break;
-		b->size += n->size;
-		curPtr += n->size;
-		DelBlock(n);
+		freeLists[fl][sl] = next;
+		if (!next)
+		{
+			slBitmap[fl] &= ~BIT(sl);
+			if (!slBitmap[fl])
+				flBitmap &= ~BIT(fl);
+		}
 	}
+	if (next) next->prevFree = prev;
+
+	b->isFree = false;
+	b->prevFree = nullptr;
+	b->nextFree = nullptr;
+	freeSpace -= b->size;
+	freeBlocks --;
 }
 
-bool MemPool::Allocate(MemChunk& chunk, u32 size, int align)
+bool MemPool::Allocate(MemChunk& chunk, u32 size, int align, MemPlacement placement)
 {
 	// Don't shift out of bounds (CERT INT34-C)
 	if(align >= 32 || align < 0)
@@ -42,6 +132,10 @@ bool MemPool::Allocate(MemChunk& chunk, u32 size, int align)
 
 	u32 alignMask = (1 << align) - 1;
 
+	// Zero-sized chunks would alias the block that follows them
+	if(size == 0)
+		size = 1;
+
 	// Check if size doesn't fit neatly in alignment
 	if(size & alignMask)
 	{
@@ -53,87 +147,231 @@ bool MemPool::Allocate(MemChunk& chunk, u32 size, int align)
 		size = (size + alignMask) &~ alignMask;
 	}
 
-	// Find the first suitable block
-	for (auto b = first; b; b = b->next)
+	MemBlock* b = nullptr;
+	u8* addr = nullptr;
+	switch (placement)
 	{
-		auto addr = b->base;
-		u32 begWaste = (u32)addr & alignMask;
-		if (begWaste > 0) begWaste = alignMask + 1 - begWaste;
-		if (begWaste > b->size) continue;
-		addr += begWaste;
-		u32 bSize = b->size - begWaste;
-		if (bSize < size) continue;
+		case MEMPLACE_GOOD_FIT:
+		default:
+		{
+			// Blocks always start at a multiple of the minimum alignment, so this is the
+			// worst case amount of padding needed to align the start of any free block.
+			u32 maxWaste = alignMask &~ ((1U << MEMPOOL_ALIGN_SHIFT) - 1);
 
-		// Found space!
-		chunk.addr = addr;
-		chunk.size = size;
+			// Round the request up to the next bin boundary: any block found in that bin
+			// or above is guaranteed to fit, which makes the common case O(1).
+			u32 searchSize = size + maxWaste;
+			if (searchSize >= (1U << MEMPOOL_FL_MIN_SHIFT))
+				searchSize += (1U << (31 - __builtin_clz(searchSize) - MEMPOOL_SL_SHIFT)) - 1;
+			if (searchSize >= size) // Did not overflow
+			{
+				int fl, sl;
+				MapSize(searchSize, fl, sl);
+				b = FindFree(fl, sl);
+			}
 
-		// Resize the block
-		if (!begWaste)
-		{
-			b->base += size;
-			b->size -= size;
-			if (!b->size)
-				DelBlock(b);
-		} else
+			// Fall back to an exhaustive search of the bins that may contain a fitting block
+			if (!b || !blockFits(b, size, alignMask))
+				b = FindFit(size, alignMask);
+			break;
+		}
+
+		case MEMPLACE_FIRST_FIT:
+			for (b = first; b; b = b->next)
+				if (b->isFree && blockFits(b, size, alignMask))
+					break;
+			break;
+
+		case MEMPLACE_BEST_FIT:
 		{
-			auto nAddr = addr + size;
-			auto nSize = bSize - size;
-			b->size = begWaste;
-			if (nSize)
+			// Blocks in higher bins are never smaller than the blocks in lower bins,
+			// so the best fit lies in the first bin that has any fitting block.
+			int fl, sl;
+			MapSize(size, fl, sl);
+			for (auto n = FindFree(fl, sl); n; )
 			{
-				// We need to add the tail chunk that wasn't used to the list
-				auto n = MemBlock::Create(nAddr, nSize);
-				if (n) InsertAfter(b, n);
-				else   chunk.size += nSize; // we have no choice but to waste the space.
+				for (; n; n = n->nextFree)
+					if ((!b || n->size < b->size) && blockFits(n, size, alignMask))
+						b = n;
+				if (b) break;
+
+				if (++sl == MEMPOOL_SL_COUNT)
+				{
+					sl = 0;
+					if (++fl == MEMPOOL_FL_COUNT)
+						break;
+				}
+				n = FindFree(fl, sl);
 			}
+			break;
 		}
-		return true;
+
+		case MEMPLACE_LAST_FIT:
+			// Carve the chunk out of the top of the highest fitting block
+			for (b = last; b; b = b->prev)
+			{
+				if (!b->isFree || b->size < size)
+					continue;
+				addr = (u8*)((u32)(b->base + b->size - size) &~ alignMask);
+				if (addr >= b->base)
+					break;
+			}
+			break;
 	}
 
-	return false;
+	if (!b)
+		return false;
+	if (!addr)
+		addr = b->base + blockAlignWaste(b, alignMask);
+
+	return Carve(chunk, b, addr, size);
 }
 
-void MemPool::Deallocate(const MemChunk& chunk)
+bool MemPool::Carve(MemChunk& chunk, MemBlock* b, u8* addr, u32 size)
 {
-	u8*  cAddr = chunk.addr;
-	auto cSize = chunk.size;
-	bool done = false;
+	RemoveFree(b);
 
-	// Try to merge the chunk somewhere into the list
-	for (auto b = first; !done && b; b = b->next)
+	u32 begWaste = addr - b->base;
+	if (begWaste)
 	{
-		auto addr = b->base;
-		if (addr > cAddr)
+		// Split off the space before the chunk into its own free block
+		auto n = NewBlock(addr, b->size - begWaste);
+		if (!n)
 		{
-			if ((cAddr + cSize) == addr)
-			{
-				// Merge the chunk to the left of the block
-				b->base = cAddr;
-				b->size += cSize;
-			} else
-			{
-				// We need to insert a new block
-				auto c = MemBlock::Create(cAddr, cSize);
-				if (c) InsertBefore(b, c);
-			}
-			done = true;
-		} else if ((b->base + b->size) == cAddr)
+			InsertFree(b);
+			return false;
+		}
+		b->size = begWaste;
+		InsertAfter(b, n);
+		InsertFree(b);
+		b = n;
+	}
+
+	u32 tailSize = b->size - size;
+	if (tailSize)
+	{
+		// We need to add the tail chunk that wasn't used to the free lists
+		auto n = NewBlock(b->base + size, tailSize);
+		if (n)
 		{
-			// Coalesce to the right
-			b->size += cSize;
-			CoalesceRight(b);
-			done = true;
+			b->size = size;
+			InsertAfter(b, n);
+			InsertFree(n);
 		}
+		// Otherwise we have no choice but to waste the space.
+	}
+
+	chunk.addr = b->base;
+	chunk.size = b->size;
+	chunk.block = b;
+	return true;
+}
+
+void MemPool::Deallocate(MemBlock* b)
+{
+	if (!b || b->isFree)
+		return;
+
+	b->isCached = false;
+	b->owner = nullptr;
+
+	// Coalesce to the left
+	auto prev = b->prev;
+	if (prev && prev->isFree && (prev->base + prev->size) == b->base)
+	{
+		RemoveFree(prev);
+		prev->size += b->size;
+		DelBlock(b);
+		b = prev;
+	}
+
+	// Coalesce to the right
+	auto next = b->next;
+	if (next && next->isFree && (b->base + b->size) == next->base)
+	{
+		RemoveFree(next);
+		b->size += next->size;
+		DelBlock(next);
+	}
+
+	InsertFree(b);
+}
+
+bool MemPool::SlideDown(MemBlock* b, int align)
+{
+	// Move a used chunk (and its contents) to the lowest suitably aligned address
+	// of the free block right before it, leaving the freed space after the chunk.
+	auto prev = b->prev, next = b->next;
+	if (b->isFree || !prev || !prev->isFree || (prev->base + prev->size) != b->base)
+		return false;
+
+	u32 alignMask = (1U << align) - 1;
+	u8* newAddr = prev->base + blockAlignWaste(prev, alignMask);
+	if (newAddr >= b->base)
+		return false;
+
+	u32 delta = b->base - newAddr;
+	bool mergeNext = next && next->isFree && (b->base + b->size) == next->base;
+
+	// The space left behind needs a descriptor of its own unless it can be merged into the
+	// next block, or the previous block is swallowed entirely (its descriptor gets reused).
+	MemBlock* gap = nullptr;
+	if (!mergeNext && newAddr != prev->base)
+	{
+		gap = NewBlock(nullptr, 0);
+		if (!gap)
+			return false;
 	}
 
-	if (!done)
+	memmove(newAddr, b->base, b->size);
+	b->base = newAddr;
+
+	RemoveFree(prev);
+	if (newAddr != prev->base)
+	{
+		prev->size = newAddr - prev->base;
+		InsertFree(prev);
+	} else if (mergeNext)
+		DelBlock(prev);
+	else
 	{
-		// Either the list is empty or the chunk address is past the end
-		// address of the last block -- let's add a new block at the end
-		auto b = MemBlock::Create(cAddr, cSize);
-		if (b) AddBlock(b);
+		// Move the descriptor over to the other side of the chunk
+		auto pprev = prev->prev, &pNext = pprev ? pprev->next : first;
+		pNext = b;
+		b->prev = pprev;
+		gap = prev;
 	}
+
+	if (mergeNext)
+	{
+		RemoveFree(next);
+		next->base -= delta;
+		next->size += delta;
+		InsertFree(next);
+	} else
+	{
+		gap->base = newAddr + b->size;
+		gap->size = delta;
+		InsertAfter(b, gap);
+		InsertFree(gap);
+	}
+
+	return true;
+}
+
+u32 MemPool::GetLargestFree()
+{
+	if (!flBitmap)
+		return 0;
+
+	// The largest block lives in the highest non-empty bin
+	int fl = 31 - __builtin_clz(flBitmap);
+	int sl = 31 - __builtin_clz(slBitmap[fl]);
+	u32 largest = 0;
+	for (auto b = freeLists[fl][sl]; b; b = b->nextFree)
+		if (b->size > largest)
+			largest = b->size;
+	return largest;
 }
 
 /*
@@ -141,14 +379,6 @@ void MemPool::Dump(const char* title)
 {
 	printf("<%s> VRAM Pool Dump\n", title);
 	for (auto b = first; b; b = b->next)
-		printf("  - %p (%u bytes)\n", b->base, b->size);
+		printf("  - %p (%u bytes)%s\n", b->base, b->size, b->isFree ? " [free]" : "");
 }
 */
-
-u32 MemPool::GetFreeSpace()
-{
-	u32 acc = 0;
-	for (auto b = first; b; b = b->next)
-		acc += b->size;
-	return acc;
-}
@@ -11,35 +11,108 @@ static inline int alignmentToShift(size_t alignment)
 	return __builtin_ffs(alignment)-1;
 }
 
+// Two-level segregated fit (TLSF) parameters. Block boundaries are always
+// multiples of the minimum alignment, so small sizes are binned linearly while
+// larger sizes get MEMPOOL_SL_COUNT bins per power of two.
+enum
+{
+	MEMPOOL_ALIGN_SHIFT  = 4,
+	MEMPOOL_SL_SHIFT     = 4,
+	MEMPOOL_SL_COUNT     = 1 << MEMPOOL_SL_SHIFT,
+	MEMPOOL_FL_MIN_SHIFT = MEMPOOL_ALIGN_SHIFT + MEMPOOL_SL_SHIFT,
+	MEMPOOL_FL_COUNT     = 32 - MEMPOOL_FL_MIN_SHIFT + 1,
+	MEMPOOL_SLAB_BLOCKS  = 64,
+};
+
+// Strategies for picking the free block a chunk is carved out of
+enum MemPlacement
+{
+	MEMPLACE_GOOD_FIT,  // Segregated fit, O(1)
+	MEMPLACE_FIRST_FIT, // Lowest-addressed fitting block
+	MEMPLACE_BEST_FIT,  // Smallest fitting block
+	MEMPLACE_LAST_FIT,  // Top of the highest-addressed fitting block
+};
+
+struct MemBlock;
+
 struct MemChunk
 {
 	u8* addr;
 	u32 size;
+	MemBlock* block;
 };
 
 struct MemBlock
 {
-	MemBlock *prev, *next;
+	MemBlock *prev, *next;         // Address-ordered neighbours (both free and used)
+	MemBlock *prevFree, *nextFree; // Links within the segregated free list
 	u8* base;
 	u32 size;
+	bool isFree;
+	bool isCached; // Used chunk parked in a linear heap thread cache
+	void* owner;   // Handle owning a relocatable chunk, if any
+};
+
+// Block descriptors are carved out of slabs owned by the pool and recycled
+// through a free list, so that allocating from the pool doesn't need to hit
+// the main heap for every chunk.
+struct MemBlockSlab
+{
+	MemBlockSlab* next;
+	MemBlock blocks[MEMPOOL_SLAB_BLOCKS];
+};
 
-	static MemBlock* Create(u8* base, u32 size)
+struct MemPool
+{
+	MemBlock *first, *last;
+	MemBlock* freeLists[MEMPOOL_FL_COUNT][MEMPOOL_SL_COUNT];
+	u32 flBitmap;
+	u32 slBitmap[MEMPOOL_FL_COUNT];
+	u32 freeSpace;
+	u32 freeBlocks;
+	MemBlockSlab* slabs;
+	MemBlock* spareBlocks;
+
+	bool Ready() { return first != nullptr; }
+
+	MemBlock* NewBlock(u8* base, u32 size)
 	{
-		auto b = (MemBlock*)malloc(sizeof(MemBlock));
-		if (!b) return nullptr;
+		auto b = spareBlocks;
+		if (b)
+			spareBlocks = b->next;
+		else
+		{
+			auto slab = (MemBlockSlab*)malloc(sizeof(MemBlockSlab));
+			if (!slab) return nullptr;
+			slab->next = slabs;
+			slabs = slab;
+
+			// Keep the first descriptor, put the rest on the spare list
+			b = &slab->blocks[0];
+			for (int i = 1; i < MEMPOOL_SLAB_BLOCKS; i ++)
+			{
+				slab->blocks[i].next = spareBlocks;
+				spareBlocks = &slab->blocks[i];
+			}
+		}
+
 		b->prev = nullptr;
 		b->next = nullptr;
+		b->prevFree = nullptr;
+		b->nextFree = nullptr;
 		b->base = base;
 		b->size = size;
+		b->isFree = false;
+		b->isCached = false;
+		b->owner = nullptr;
 		return b;
 	}
-};
 
-struct MemPool
-{
-	MemBlock *first, *last;
-
-	bool Ready() { return first != nullptr; }
+	void FreeBlock(MemBlock* b)
+	{
+		b->next = spareBlocks;
+		spareBlocks = b;
+	}
 
 	void AddBlock(MemBlock* blk)
 	{
@@ -47,6 +120,7 @@ struct MemPool
 		if (last) last->next = blk;
 		if (!first) first = blk;
 		last = blk;
+		InsertFree(blk);
 	}
 
 	void DelBlock(MemBlock* b)
@@ -55,16 +129,7 @@ struct MemPool
 		auto next = b->next, &nPrev = next ? next->prev : last;
 		pNext = next;
 		nPrev = prev;
-		free(b);
-	}
-
-	void InsertBefore(MemBlock* b, MemBlock* p)
-	{
-		auto prev = b->prev, &pNext = prev ? prev->next : first;
-		b->prev = p;
-		p->next = b;
-		p->prev = prev;
-		pNext = p;
+		FreeBlock(b);
 	}
 
 	void InsertAfter(MemBlock* b, MemBlock* n)
@@ -76,24 +141,42 @@ struct MemPool
 		nPrev = n;
 	}
 
-	//void CoalesceLeft(MemBlock* b);
-	void CoalesceRight(MemBlock* b);
+	static void MapSize(u32 size, int& fl, int& sl);
+	MemBlock* FindFree(int& fl, int& sl);
+	MemBlock* FindFit(u32 size, u32 alignMask);
+	void InsertFree(MemBlock* b);
+	void RemoveFree(MemBlock* b);
 
-	bool Allocate(MemChunk& chunk, u32 size, int align);
-	void Deallocate(const MemChunk& chunk);
+	bool Carve(MemChunk& chunk, MemBlock* b, u8* addr, u32 size);
+	bool Allocate(MemChunk& chunk, u32 size, int align, MemPlacement placement = MEMPLACE_GOOD_FIT);
+	void Deallocate(MemBlock* b);
+	bool SlideDown(MemBlock* b, int align);
 
 	void Destroy()
 	{
-		MemBlock* next = nullptr;
-		for (auto b = first; b; b = next)
+		MemBlockSlab* next = nullptr;
+		for (auto slab = slabs; slab; slab = next)
 		{
-			next = b->next;
-			free(b);
+			next = slab->next;
+			free(slab);
 		}
+		slabs = nullptr;
+		spareBlocks = nullptr;
 		first = nullptr;
 		last = nullptr;
+		for (int i = 0; i < MEMPOOL_FL_COUNT; i ++)
+		{
+			for (int j = 0; j < MEMPOOL_SL_COUNT; j ++)
+				freeLists[i][j] = nullptr;
+			slBitmap[i] = 0;
+		}
+		flBitmap = 0;
+		freeSpace = 0;
+		freeBlocks = 0;
 	}
 
 	//void Dump(const char* title);
-	u32 GetFreeSpace();
+	u32 GetFreeSpace() { return freeSpace; }
+	u32 GetFreeBlocks() { return freeBlocks; }
+	u32 GetLargestFree();
 };
@@ -3,33 +3,33 @@ extern "C"
 	#include <3ds/types.h>
 	#include <3ds/os.h>
 	#include <3ds/allocator/vram.h>
-	#include <3ds/util/rbtree.h>
 }
 
 #include "mem_pool.h"
 #include "addrmap.h"
 
 static MemPool sVramPoolA, sVramPoolB;
+static vramPlacementPolicy sVramPolicy = VRAM_PLACE_GOOD_FIT;
+static u32 sVramSegregationThreshold = 0x10000;
 
 static bool vramInit()
 {
 	if (sVramPoolA.Ready() || sVramPoolB.Ready())
 		return true;
 
-	auto blkA = MemBlock::Create((u8*)OS_VRAM_VADDR,                  OS_VRAM_SIZE/2);
+	auto blkA = sVramPoolA.NewBlock((u8*)OS_VRAM_VADDR,                  OS_VRAM_SIZE/2);
 	if (!blkA)
 		return false;
 
-	auto blkB = MemBlock::Create((u8*)OS_VRAM_VADDR + OS_VRAM_SIZE/2, OS_VRAM_SIZE/2);
+	auto blkB = sVramPoolB.NewBlock((u8*)OS_VRAM_VADDR + OS_VRAM_SIZE/2, OS_VRAM_SIZE/2);
 	if (!blkB)
 	{
-		free(blkA);
+		sVramPoolA.FreeBlock(blkA);
 		return false;
 	}
 
 	sVramPoolA.AddBlock(blkA);
 	sVramPoolB.AddBlock(blkB);
-	rbtree_init(&sAddrMap, addrMapNodeComparator);
 	return true;
 }
 
@@ -45,6 +45,28 @@ static MemPool* vramPoolForAddr(void* addr)
 	return nullptr;
 }
 
+static bool vramAllocFrom(MemPool& pool, MemChunk& chunk, size_t size, int shift)
+{
+	MemPlacement placement;
+	switch (sVramPolicy)
+	{
+		default:
+		case VRAM_PLACE_GOOD_FIT:
+			placement = MEMPLACE_GOOD_FIT;
+			break;
+		case VRAM_PLACE_FIRST_FIT:
+			placement = MEMPLACE_FIRST_FIT;
+			break;
+		case VRAM_PLACE_BEST_FIT:
+			placement = MEMPLACE_BEST_FIT;
+			break;
+		case VRAM_PLACE_SEGREGATED:
+			placement = size >= sVramSegregationThreshold ? MEMPLACE_LAST_FIT : MEMPLACE_FIRST_FIT;
+			break;
+	}
+	return pool.Allocate(chunk, size, shift, placement);
+}
+
 void* vramAlloc(size_t size)
 {
 	return vramMemAlignAt(size, 0x80, VRAM_ALLOC_ANY);
@@ -79,10 +101,10 @@ void* vramMemAlignAt(size_t size, size_t alignment, vramAllocPos pos)
 		default:
 			break;
 		case VRAM_ALLOC_A:
-			didAlloc = sVramPoolA.Allocate(chunk, size, shift);
+			didAlloc = vramAllocFrom(sVramPoolA, chunk, size, shift);
 			break;
 		case VRAM_ALLOC_B:
-			didAlloc = sVramPoolB.Allocate(chunk, size, shift);
+			didAlloc = vramAllocFrom(sVramPoolB, chunk, size, shift);
 			break;
 		case VRAM_ALLOC_ANY:
 		{
@@ -91,8 +113,8 @@ void* vramMemAlignAt(size_t size, size_t alignment, vramAllocPos pos)
 			MemPool& firstPool = prefer_a ? sVramPoolA : sVramPoolB;
 			MemPool& secondPool = prefer_a ? sVramPoolB : sVramPoolA;
 
-			didAlloc = firstPool.Allocate(chunk, size, shift);
-			if (!didAlloc) didAlloc = secondPool.Allocate(chunk, size, shift);
+			didAlloc = vramAllocFrom(firstPool, chunk, size, shift);
+			if (!didAlloc) didAlloc = vramAllocFrom(secondPool, chunk, size, shift);
 			break;
 		}
 	}
@@ -100,13 +122,11 @@ void* vramMemAlignAt(size_t size, size_t alignment, vramAllocPos pos)
 	if (!didAlloc)
 		return nullptr;
 
-	auto node = newNode(chunk);
-	if (!node)
+	if (!sAddrMap.Insert(chunk.block))
 	{
-		vramPoolForAddr(chunk.addr)->Deallocate(chunk);
+		vramPoolForAddr(chunk.addr)->Deallocate(chunk.block);
 		return nullptr;
 	}
-	if (rbtree_insert(&sAddrMap, &node->node));
 	return chunk.addr;
 }
 
@@ -118,23 +138,55 @@ void* vramRealloc(void* mem, size_t size)
 
 size_t vramGetSize(void* mem)
 {
-	auto node = getNode(mem);
-	return node ? node->chunk.size : 0;
+	auto blk = sAddrMap.Find(mem);
+	return blk ? blk->size : 0;
 }
 
 void vramFree(void* mem)
 {
-	auto node = getNode(mem);
-	if (!node) return;
+	auto blk = sAddrMap.Find(mem);
+	if (!blk) return;
 
-	// Free the chunk
-	vramPoolForAddr(mem)->Deallocate(node->chunk);
-
-	// Free the node
-	delNode(node);
+	// Forget the chunk, then free it
+	sAddrMap.Remove(blk);
+	vramPoolForAddr(mem)->Deallocate(blk);
 }
 
 u32 vramSpaceFree()
 {
 	return sVramPoolA.GetFreeSpace() + sVramPoolB.GetFreeSpace();
 }
+
+void vramSetPlacementPolicy(vramPlacementPolicy policy)
+{
+	sVramPolicy = policy;
+}
+
+void vramSetSegregationThreshold(u32 size)
+{
+	sVramSegregationThreshold = size;
+}
+
+void vramGetFragmentationInfo(vramAllocPos pos, vramFragmentationInfo* out)
+{
+	out->freeSpace   = 0;
+	out->largestFree = 0;
+	out->freeExtents = 0;
+
+	if (!vramInit())
+		return;
+
+	MemPool* pools[] = { &sVramPoolA, &sVramPoolB };
+	for (int i = 0; i < 2; i ++)
+	{
+		if (!(pos & BIT(i)))
+			continue;
+
+		MemPool* pool = pools[i];
+		u32 largest = pool->GetLargestFree();
+		out->freeSpace   += pool->GetFreeSpace();
+		out->freeExtents += pool->GetFreeBlocks();
+		if (largest > out->largestFree)
+			out->largestFree = largest;
+	}
+}
@@ -15,6 +15,8 @@
 #include <3ds/util/utf.h>
 
 #include "path_buf.h"
+#include "fs_cache.h"
+#include "util/utf/utf_internal.h"
 
 /*! @internal
  *
@@ -51,9 +53,10 @@ static int       sdmc_statvfs(struct _reent *r, const char *path, struct statvfs
 /*! Open file struct */
 typedef struct
 {
-  Handle fd;     /*! CTRU handle */
-  int    flags;  /*! Flags used in open(2) */
-  u64    offset; /*! Current file offset */
+  Handle            fd;     /*! CTRU handle */
+  int               flags;  /*! Flags used in open(2) */
+  u64               offset; /*! Current file offset */
+  fs_cache_stream_t stream; /*! Block cache read-ahead state */
 } archive_file_t;
 
 /*! archive devoptab */
@@ -96,14 +99,35 @@ typedef struct
     s32 id;
     devoptab_t device;
     FS_Archive archive;
-    char* cwd;
+    uint16_t* cwd;
+    size_t cwd_len;
     char name[32];
 } archive_fsdevice;
 
+#define ARCHIVE_PATH_CACHE_SIZE 4  // Resolved paths remembered per thread
+#define ARCHIVE_PATH_CACHE_MAX  96 // Longest path remembered, in bytes and UTF-16 code units
+
+/*! Resolved path */
+typedef struct
+{
+  u32              generation;                    /*! archive_path_generation it was resolved in */
+  archive_fsdevice *in_device;                    /*! Device it was resolved on, or NULL */
+  archive_fsdevice *device;                       /*! Device it resolved to */
+  size_t           units;                         /*! Length of the UTF-16 path */
+  char             path[ARCHIVE_PATH_CACHE_MAX];  /*! Path as given */
+  uint16_t         utf16[ARCHIVE_PATH_CACHE_MAX]; /*! Resolved UTF-16 path */
+} archive_path_cache_t;
+
 static bool archive_initialized = false;
 static s32 archive_device_cwd;
 static archive_fsdevice archive_devices[8];
 
+// Bumped whenever a working directory or mount changes, which invalidates
+// every thread's resolved paths
+static u32 archive_path_generation = 1;
+static __thread archive_path_cache_t archive_path_cache[ARCHIVE_PATH_CACHE_SIZE];
+static __thread u32 archive_path_cache_next;
+
 /*! @endcond */
 
 static archive_fsdevice *archiveFindDevice(const char *name)
@@ -135,89 +159,131 @@ static archive_fsdevice *archiveFindDevice(const char *name)
   return NULL;
 }
 
-static const char*
-archive_fixpath(struct _reent    *r,
-                const char       *path,
-                archive_fsdevice **device)
+/*! Resolve a path to a UTF-16 path on its device
+ *
+ *  The device prefix is split off, the working directory is joined to
+ *  relative paths and the result is transcoded in a single pass into
+ *  __ctru_dev_utf16_buf.
+ *
+ *  @param[in,out] r      newlib reentrancy struct
+ *  @param[in]     path   Path to resolve
+ *  @param[in,out] device Device to resolve on, or NULL to use the path's;
+ *                        set to the resolved device
+ *
+ *  @returns number of UTF-16 code units in the resolved path
+ *  @returns -1 for error
+ */
+static ssize_t
+archive_resolvepath(struct _reent    *r,
+                    const char       *path,
+                    archive_fsdevice **device)
 {
   ssize_t       units;
   uint32_t      code;
   const uint8_t *p = (const uint8_t*)path;
-  const char *device_path = path;
+  const char    *colon = strchr(path, ':');
+  uint16_t      *out = __ctru_dev_utf16_buf;
+  size_t        len = 0;
+  bool          too_long = false;
 
-  // Move the path pointer to the start of the actual path
-  do
+  // Make sure the device name is valid UTF-8; p then points to the actual path
+  if(colon != NULL)
   {
-    units = decode_utf8(&code, p);
-    if(units < 0)
+    while(p != (const uint8_t*)colon)
     {
-      r->_errno = EILSEQ;
-      return NULL;
+      units = decode_utf8(&code, p);
+      if(units < 0)
+      {
+        r->_errno = EILSEQ;
+        return -1;
+      }
+
+      p += units;
     }
 
-    p += units;
-  } while(code != ':' && code != 0);
+    ++p;
+  }
+
+  archive_fsdevice *dev = NULL;
+  if(*device != NULL)
+    dev = *device;
+  else if(colon != NULL)
+    dev = archiveFindDevice(path);
+  else if(archive_device_cwd != -1)
+    dev = &archive_devices[archive_device_cwd];
 
-  // We found a colon; p points to the actual path
-  if(code == ':')
-    path = (const char*)p;
+  // Relative paths start from the working directory
+  if(dev != NULL && *p != '/')
+  {
+    if(dev->cwd_len + 1 > PATH_MAX)
+      too_long = true;
+    else
+    {
+      memcpy(out, dev->cwd, dev->cwd_len * sizeof(uint16_t));
+      len = dev->cwd_len;
+      out[len++] = '/';
+    }
+  }
 
-  // Make sure there are no more colons and that the
-  // remainder of the filename is valid UTF-8
-  p = (const uint8_t*)path;
-  do
+  // Transcode the rest, making sure there are no more colons and that it is
+  // valid UTF-8
+  for(;;)
   {
+    // ASCII without colons, a word at a time
+    while(is_aligned(p) && len + 4 <= PATH_MAX)
+    {
+      uint32_t word = load_word(p);
+      if(!is_ascii8(word) || !is_ascii8(word ^ 0x3A3A3A3A))
+        break;
+
+      out[len+0] = p[0];
+      out[len+1] = p[1];
+      out[len+2] = p[2];
+      out[len+3] = p[3];
+      len += 4;
+      p   += 4;
+    }
+
     units = decode_utf8(&code, p);
     if(units < 0)
     {
       r->_errno = EILSEQ;
-      return NULL;
+      return -1;
     }
 
+    if(code == 0)
+      break;
+
     if(code == ':')
     {
       r->_errno = EINVAL;
-      return NULL;
+      return -1;
     }
 
     p += units;
-  } while(code != 0);
 
-  archive_fsdevice *dev = NULL;
-  if(device != NULL && *device != NULL)
-    dev = *device;
-  else if(path != device_path)
-    dev = archiveFindDevice(device_path);
-  else if(archive_device_cwd != -1)
-    dev = &archive_devices[archive_device_cwd];
-  if(dev == NULL)
-  {
-    r->_errno = ENODEV;
-    return NULL;
+    if(len + (code < 0x10000 ? 1 : 2) > PATH_MAX)
+      too_long = true;
+    else
+      len += encode_utf16(&out[len], code);
   }
 
-  if(path[0] == '/')
-    strncpy(__ctru_dev_path_buf, path, PATH_MAX);
-  else
+  if(dev == NULL)
   {
-    size_t cwdlen = strlen(dev->cwd);
-    strncpy(__ctru_dev_path_buf, dev->cwd, PATH_MAX);
-    __ctru_dev_path_buf[PATH_MAX] = '\0';
-    strncat(__ctru_dev_path_buf, "/", PATH_MAX - cwdlen);
-    strncat(__ctru_dev_path_buf, path, PATH_MAX - cwdlen - 1);
+    r->_errno = ENODEV;
+    return -1;
   }
 
-  if(__ctru_dev_path_buf[PATH_MAX] != 0)
+  if(too_long)
   {
-    __ctru_dev_path_buf[PATH_MAX] = 0;
     r->_errno = ENAMETOOLONG;
-    return NULL;
+    return -1;
   }
 
-  if(device)
-    *device = dev;
+  out[len] = 0;
 
-  return __ctru_dev_path_buf;
+  *device = dev;
+  return len;
 }
 
 static const FS_Path
@@ -227,25 +293,50 @@ archive_utf16path(struct _reent    *r,
 {
   ssize_t units;
   FS_Path fspath;
+  archive_fsdevice *dev = device != NULL ? *device : NULL;
+  u32 generation = __atomic_load_n(&archive_path_generation, __ATOMIC_ACQUIRE);
+  archive_path_cache_t *entry;
 
   fspath.data = NULL;
 
-  if(archive_fixpath(r, path, device) == NULL)
-    return fspath;
-
-  units = utf8_to_utf16(__ctru_dev_utf16_buf, (const uint8_t*)__ctru_dev_path_buf, PATH_MAX);
-  if(units < 0)
+  // Stat-then-open and similar patterns resolve the same path repeatedly
+  for(entry = archive_path_cache; entry < archive_path_cache + ARCHIVE_PATH_CACHE_SIZE; ++entry)
   {
-    r->_errno = EILSEQ;
-    return fspath;
+    if(entry->generation == generation && entry->in_device == dev
+    && strncmp(entry->path, path, sizeof(entry->path)) == 0)
+      break;
   }
-  if(units > PATH_MAX)
+
+  if(entry < archive_path_cache + ARCHIVE_PATH_CACHE_SIZE)
   {
-    r->_errno = ENAMETOOLONG;
-    return fspath;
+    units = entry->units;
+    memcpy(__ctru_dev_utf16_buf, entry->utf16, (units+1)*sizeof(uint16_t));
+    if(device)
+      *device = entry->device;
   }
+  else
+  {
+    archive_fsdevice *resolved = dev;
+    units = archive_resolvepath(r, path, &resolved);
+    if(units < 0)
+      return fspath;
 
-  __ctru_dev_utf16_buf[units] = 0;
+    if(device)
+      *device = resolved;
+
+    // Remember short paths, replacing entries round-robin
+    size_t len = strnlen(path, ARCHIVE_PATH_CACHE_MAX);
+    if(len < ARCHIVE_PATH_CACHE_MAX && units < ARCHIVE_PATH_CACHE_MAX)
+    {
+      entry = &archive_path_cache[archive_path_cache_next++ % ARCHIVE_PATH_CACHE_SIZE];
+      entry->generation = generation;
+      entry->in_device  = dev;
+      entry->device     = resolved;
+      entry->units      = units;
+      memcpy(entry->path, path, len+1);
+      memcpy(entry->utf16, __ctru_dev_utf16_buf, (units+1)*sizeof(uint16_t));
+    }
+  }
 
   fspath.type = PATH_UTF16;
   fspath.size = (units+1)*sizeof(uint16_t);
@@ -301,12 +392,14 @@ static int _archiveMountDevice(FS_Archive       archive,
     goto _fail;
 
   device->setup = 1;
-  device->cwd = malloc(PATH_MAX+1);
+  device->cwd = malloc((PATH_MAX+1)*sizeof(uint16_t));
   device->cwd[0] = '/';
-  device->cwd[1] = '\0';
+  device->cwd[1] = 0;
+  device->cwd_len = 1;
 
   if (archive_device_cwd==-1)
     archive_device_cwd = device->id;
+  __atomic_add_fetch(&archive_path_generation, 1, __ATOMIC_RELEASE);
 
   const devoptab_t *default_dev = GetDeviceOpTab("");
   if(default_dev==NULL || strcmp(default_dev->name, "stdnull")==0)
@@ -440,6 +533,7 @@ Result _archiveUnmountDeviceStruct(archive_fsdevice *device)
 
   if(device->id == archive_device_cwd)
     archive_device_cwd = -1;
+  __atomic_add_fetch(&archive_path_generation, 1, __ATOMIC_RELEASE);
 
   device->setup = 0;
   memset(device->name, 0, sizeof(device->name));
@@ -579,6 +673,8 @@ archive_open(struct _reent *r,
     file->fd     = fd;
     file->flags  = (flags & (O_ACCMODE|O_APPEND|O_SYNC));
     file->offset = 0;
+    file->stream.next   = 0;
+    file->stream.window = 0;
     return 0;
   }
 
@@ -603,6 +699,9 @@ archive_close(struct _reent *r,
   /* get pointer to our data */
   archive_file_t *file = (archive_file_t*)fd;
 
+  /* the handle may be recycled, forget its cached blocks */
+  fsCacheInvalidate(file->fd);
+
   rc = FSFILE_Close(file->fd);
   if(R_SUCCEEDED(rc))
     return 0;
@@ -658,6 +757,10 @@ archive_write(struct _reent *r,
 
   rc = FSFILE_Write(file->fd, &bytes, file->offset,
                     (u32*)ptr, len, sync);
+
+  /* drop cached blocks, even a failed write may have changed the file */
+  fsCacheInvalidate(file->fd);
+
   if(R_FAILED(rc))
   {
     r->_errno = archive_translate_error(rc);
@@ -699,7 +802,7 @@ archive_read(struct _reent *r,
   }
 
   /* read the data */
-  rc = FSFILE_Read(file->fd, &bytes, file->offset, (u32*)ptr, (u32)len);
+  rc = fsCacheRead(file->fd, &file->stream, file->offset, ptr, (u32)len, &bytes);
   if(R_SUCCEEDED(rc))
   {
     /* update current file offset */
@@ -904,8 +1007,9 @@ archive_chdir(struct _reent *r,
   if(R_SUCCEEDED(rc))
   {
     FSDIR_Close(fd);
-    strncpy(device->cwd, __ctru_dev_path_buf, PATH_MAX + 1);
-    device->cwd[PATH_MAX] = '\0';
+    memcpy(device->cwd, fs_path.data, fs_path.size);
+    device->cwd_len = fs_path.size / sizeof(uint16_t) - 1;
+    __atomic_add_fetch(&archive_path_generation, 1, __ATOMIC_RELEASE);
     return 0;
   }
 
@@ -1074,6 +1178,26 @@ archive_diropen(struct _reent *r,
   return NULL;
 }
 
+/*! Fill in stat info from a directory entry
+ *
+ *  @param[out] st    Buffer to store entry attributes
+ *  @param[in]  entry Directory entry
+ */
+static void
+archive_entry_stat(struct stat             *st,
+                   const FS_DirectoryEntry *entry)
+{
+  memset(st, 0, sizeof(struct stat));
+  st->st_nlink = 1;
+  if(entry->attributes & FS_ATTRIBUTE_DIRECTORY)
+    st->st_mode = S_IFDIR | S_IRWXU | S_IRWXG | S_IRWXO;
+  else
+  {
+    st->st_size = (off_t)entry->fileSize;
+    st->st_mode = S_IFREG | S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+  }
+}
+
 /*! Fetch the next entry of an open directory
  *
  *  @param[in,out] r        newlib reentrancy struct
@@ -1132,12 +1256,8 @@ archive_dirnext(struct _reent *r,
   {
     entry = &dir->entry_data[dir->index];
 
-    /* fill in the stat info */
-    filestat->st_ino = 0;
-    if(entry->attributes & FS_ATTRIBUTE_DIRECTORY)
-      filestat->st_mode = S_IFDIR;
-    else
-      filestat->st_mode = S_IFREG;
+    /* fill in the stat info, the entry has everything stat(2) would return */
+    archive_entry_stat(filestat, entry);
 
     /* convert name from UTF-16 to UTF-8 */
     memset(filename, 0, NAME_MAX);
@@ -1161,6 +1281,104 @@ archive_dirnext(struct _reent *r,
   return -1;
 }
 
+/*! Read a batch of entries of an open directory
+ *
+ *  @param[in,out] dirp         Directory opened with opendir(3)
+ *  @param[out]    entries      Buffer to store entries
+ *  @param[in]     count        Maximum number of entries to read
+ *  @param[out]    namebuf      Buffer to store entry names
+ *  @param[in]     namebuf_size Size of namebuf
+ *
+ *  @returns number of entries read, 0 at end-of-directory
+ *  @returns -1 for error
+ */
+ssize_t
+archiveDirRead(DIR              *dirp,
+               archive_dirent_t *entries,
+               size_t           count,
+               char             *namebuf,
+               size_t           namebuf_size)
+{
+  Result            rc;
+  u32               read;
+  ssize_t           units;
+  size_t            n = 0, used = 0;
+  archive_dir_t     *dir;
+  FS_DirectoryEntry *entry;
+
+  /* make sure this is an archive directory */
+  if(dirp == NULL || dirp->dirData == NULL
+  || ((archive_dir_t*)dirp->dirData->dirStruct)->magic != ARCHIVE_DIRITER_MAGIC)
+  {
+    errno = EBADF;
+    return -1;
+  }
+
+  dir = (archive_dir_t*)dirp->dirData->dirStruct;
+
+  static const size_t max_entries = sizeof(dir->entry_data) / sizeof(dir->entry_data[0]);
+
+  while(n < count)
+  {
+    /* fetch the next batch once this one is used up; this picks up
+     * where readdir(3) left off, so both can be mixed */
+    if(dir->index + 1 >= (ssize_t)dir->size)
+    {
+      dir->index = -1;
+      dir->size  = 0;
+
+      rc = FSDIR_Read(dir->fd, &read, max_entries, dir->entry_data);
+      if(R_FAILED(rc))
+      {
+        if(n)
+          break;
+        errno = archive_translate_error(rc);
+        return -1;
+      }
+
+      /* end-of-directory */
+      if(read == 0)
+        break;
+
+      dir->size = read;
+    }
+
+    /* convert name from UTF-16 to UTF-8, straight into the name buffer */
+    entry = &dir->entry_data[dir->index + 1];
+    units = utf16_to_utf8((uint8_t*)namebuf + used, entry->name, namebuf_size - used);
+    if(units < 0)
+    {
+      /* skip the entry, like readdir(3) does */
+      ++dir->index;
+      if(n)
+        break;
+      errno = EILSEQ;
+      return -1;
+    }
+
+    if((size_t)units >= namebuf_size - used)
+    {
+      /* out of room, leave the entry for the next call */
+      if(n)
+        break;
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+
+    namebuf[used + units] = 0;
+    entries[n].name       = namebuf + used;
+    entries[n].attributes = entry->attributes;
+    entries[n].size       = entry->fileSize;
+
+    used += units + 1;
+    ++dir->index;
+    ++n;
+  }
+
+  dirp->position += n;
+  return n;
+}
+
 /*! Close an open directory
  *
  *  @param[in,out] r        newlib reentrancy struct
@@ -1260,6 +1478,7 @@ archive_ftruncate(struct _reent *r,
 
   /* set the new file size */
   rc = FSFILE_SetSize(file->fd, len);
+  fsCacheInvalidate(file->fd);
   if(R_SUCCEEDED(rc))
     return 0;
 
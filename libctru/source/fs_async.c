@@ -0,0 +1,262 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+#include <3ds/synchronization.h>
+#include <3ds/thread.h>
+#include <3ds/services/fs.h>
+#include <3ds/fs_async.h>
+
+#define FS_ASYNC_STACK_SIZE   0x2000
+#define FS_ASYNC_MAX_COALESCE 0x40000 // Largest read issued for a run of adjacent requests
+#define FS_ASYNC_MAX_RUN      16      // Most requests served by a single read
+
+enum
+{
+	FS_ASYNC_PENDING = 0,
+	FS_ASYNC_DONE    = 1,
+};
+
+static int fsAsyncRefCount;
+static LightLock fsAsyncLock = 1;
+static CondVar fsAsyncCond;
+static fsAsyncRequest *fsAsyncHead, *fsAsyncTail;
+static Thread fsAsyncThreads[FS_ASYNC_MAX_WORKERS];
+static u32 fsAsyncThreadCount;
+static bool fsAsyncRunning;
+
+// Must be called with fsAsyncLock held
+static u32 fsAsyncTakeRun(fsAsyncRequest** run)
+{
+	fsAsyncRequest* req = fsAsyncHead;
+	fsAsyncHead = req->next;
+	if (!fsAsyncHead)
+		fsAsyncTail = NULL;
+
+	u32 count = 1;
+	u64 end = req->offset + req->size;
+	u32 total = req->size;
+	run[0] = req;
+
+	// Pull queued requests which pick up right where the run ends
+	bool found = true;
+	while (found && count < FS_ASYNC_MAX_RUN && total < FS_ASYNC_MAX_COALESCE)
+	{
+		found = false;
+		fsAsyncRequest* prev = NULL;
+		for (fsAsyncRequest* cur = fsAsyncHead; cur; prev = cur, cur = cur->next)
+		{
+			if (cur->fd != req->fd || cur->offset != end || cur->size > FS_ASYNC_MAX_COALESCE - total)
+				continue;
+
+			if (prev) prev->next = cur->next;
+			else fsAsyncHead = cur->next;
+			if (fsAsyncTail == cur)
+				fsAsyncTail = prev;
+
+			run[count++] = cur;
+			end += cur->size;
+			total += cur->size;
+			found = true;
+			break;
+		}
+	}
+
+	return count;
+}
+
+static void fsAsyncComplete(fsAsyncRequest* req, Result rc, u32 bytesRead)
+{
+	req->result = rc;
+	req->bytesRead = bytesRead;
+	if (req->callback)
+		req->callback(req);
+
+	// Signal the event first: the request and its event may be reused as soon as it is marked as done
+	if (req->event)
+		LightEvent_Signal(req->event);
+	__atomic_store_n(&req->state, FS_ASYNC_DONE, __ATOMIC_RELEASE);
+	syncArbitrateAddress(&req->state, ARBITRATION_SIGNAL, -1);
+}
+
+static void fsAsyncProcess(fsAsyncRequest** run, u32 count)
+{
+	u32 total = 0, i;
+	bool contiguous = true;
+	for (i = 0; i < count; i ++)
+	{
+		if (i && (u8*)run[i]->buffer != (u8*)run[i-1]->buffer + run[i-1]->size)
+			contiguous = false;
+		total += run[i]->size;
+	}
+
+	// Scattered buffers are read into a bounce buffer first
+	u8* buf = contiguous ? (u8*)run[0]->buffer : (u8*)malloc(total);
+	if (!buf)
+	{
+		for (i = 0; i < count; i ++)
+		{
+			u32 bytesRead = 0;
+			Result rc = FSFILE_Read(run[i]->fd, &bytesRead, run[i]->offset, run[i]->buffer, run[i]->size);
+			fsAsyncComplete(run[i], rc, bytesRead);
+		}
+		return;
+	}
+
+	u32 bytesRead = 0;
+	Result rc = FSFILE_Read(run[0]->fd, &bytesRead, run[0]->offset, buf, total);
+
+	u32 pos = 0;
+	for (i = 0; i < count; i ++)
+	{
+		fsAsyncRequest* req = run[i];
+		u32 n = 0;
+		if (R_SUCCEEDED(rc) && bytesRead > pos)
+			n = bytesRead - pos < req->size ? bytesRead - pos : req->size;
+		if (!contiguous)
+			memcpy(req->buffer, buf + pos, n);
+		pos += req->size;
+		fsAsyncComplete(req, rc, n);
+	}
+
+	if (!contiguous)
+		free(buf);
+}
+
+static void fsAsyncThreadMain(void* arg)
+{
+	fsAsyncRequest* run[FS_ASYNC_MAX_RUN];
+
+	LightLock_Lock(&fsAsyncLock);
+	for (;;)
+	{
+		while (!fsAsyncHead && fsAsyncRunning)
+			CondVar_Wait(&fsAsyncCond, &fsAsyncLock);
+
+		// Only quit once the queue is drained
+		if (!fsAsyncHead)
+			break;
+
+		u32 count = fsAsyncTakeRun(run);
+		LightLock_Unlock(&fsAsyncLock);
+		fsAsyncProcess(run, count);
+		LightLock_Lock(&fsAsyncLock);
+	}
+	LightLock_Unlock(&fsAsyncLock);
+}
+
+Result fsAsyncInit(u32 numWorkers, int priority, int core_id)
+{
+	if (AtomicPostIncrement(&fsAsyncRefCount)) return 0;
+
+	if (numWorkers < 1 || numWorkers > FS_ASYNC_MAX_WORKERS)
+	{
+		AtomicDecrement(&fsAsyncRefCount);
+		return MAKERESULT(RL_USAGE, RS_INVALIDARG, RM_APPLICATION, RD_OUT_OF_RANGE);
+	}
+
+	fsAsyncRunning = true;
+	CondVar_Init(&fsAsyncCond);
+	for (fsAsyncThreadCount = 0; fsAsyncThreadCount < numWorkers; fsAsyncThreadCount ++)
+	{
+		Thread thread = threadCreate(fsAsyncThreadMain, NULL, FS_ASYNC_STACK_SIZE, priority, core_id, false);
+		if (!thread)
+			break;
+		fsAsyncThreads[fsAsyncThreadCount] = thread;
+	}
+
+	if (!fsAsyncThreadCount)
+	{
+		fsAsyncRunning = false;
+		AtomicDecrement(&fsAsyncRefCount);
+		return MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY);
+	}
+
+	return 0;
+}
+
+void fsAsyncExit(void)
+{
+	if (AtomicDecrement(&fsAsyncRefCount)) return;
+
+	LightLock_Lock(&fsAsyncLock);
+	fsAsyncRunning = false;
+	CondVar_Broadcast(&fsAsyncCond);
+	LightLock_Unlock(&fsAsyncLock);
+
+	for (u32 i = 0; i < fsAsyncThreadCount; i ++)
+	{
+		threadJoin(fsAsyncThreads[i], U64_MAX);
+		threadFree(fsAsyncThreads[i]);
+	}
+	fsAsyncThreadCount = 0;
+}
+
+Result fsAsyncSubmit(fsAsyncRequest* reqs, u32 count)
+{
+	if (!count)
+		return 0;
+
+	for (u32 i = 0; i < count; i ++)
+	{
+		reqs[i].state = FS_ASYNC_PENDING;
+		reqs[i].next = i + 1 < count ? &reqs[i+1] : NULL;
+	}
+
+	LightLock_Lock(&fsAsyncLock);
+	if (!fsAsyncRunning)
+	{
+		LightLock_Unlock(&fsAsyncLock);
+		return MAKERESULT(RL_USAGE, RS_INVALIDSTATE, RM_APPLICATION, RD_NOT_INITIALIZED);
+	}
+
+	if (fsAsyncTail)
+		fsAsyncTail->next = &reqs[0];
+	else
+		fsAsyncHead = &reqs[0];
+	fsAsyncTail = &reqs[count-1];
+
+	CondVar_WakeUp(&fsAsyncCond, count < fsAsyncThreadCount ? count : fsAsyncThreadCount);
+	LightLock_Unlock(&fsAsyncLock);
+	return 0;
+}
+
+Result fsAsyncRead(fsAsyncRequest* req, Handle fd, u64 offset, void* buffer, u32 size, fsAsyncCallback callback, void* user)
+{
+	req->fd = fd;
+	req->offset = offset;
+	req->buffer = buffer;
+	req->size = size;
+	req->callback = callback;
+	req->user = user;
+	req->event = NULL;
+	return fsAsyncSubmit(req, 1);
+}
+
+bool fsAsyncIsDone(const fsAsyncRequest* req)
+{
+	return __atomic_load_n(&req->state, __ATOMIC_ACQUIRE) == FS_ASYNC_DONE;
+}
+
+Result fsAsyncWait(fsAsyncRequest* req)
+{
+	// The event may have been signaled for another request sharing it, so always wait on the request itself
+	while (!fsAsyncIsDone(req))
+		syncArbitrateAddress(&req->state, ARBITRATION_WAIT_IF_LESS_THAN, FS_ASYNC_DONE);
+
+	return req->result;
+}
+
+Result fsAsyncWaitAll(fsAsyncRequest* reqs, u32 count)
+{
+	Result res = 0;
+	for (u32 i = 0; i < count; i ++)
+	{
+		Result rc = fsAsyncWait(&reqs[i]);
+		if (R_FAILED(rc) && R_SUCCEEDED(res))
+			res = rc;
+	}
+	return res;
+}
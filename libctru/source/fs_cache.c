@@ -0,0 +1,379 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/synchronization.h>
+#include <3ds/archive.h>
+#include <3ds/services/fs.h>
+
+#include "fs_cache.h"
+
+// Upper bound on the number of blocks fetched by a single FS read
+#define FS_CACHE_MAX_RUN 32
+#define FS_CACHE_NONE    ((u32)~0)
+
+typedef struct
+{
+	Handle fd;
+	u32    valid;      // Bytes of file data held (short at end-of-file), 0 if unused
+	u64    block;
+	u32    prev, next; // LRU list, most recently used first
+	u32    chain;      // Next entry in the same hash bucket
+	u32    filePrev, fileNext; // Entries whose handle falls in the same file bucket
+} fs_cache_entry;
+
+static LightLock sCacheLock = 1;
+static LightLock sCacheRunLock = 1; // Taken before sCacheLock, guards sCacheRun
+static u8 *sCacheData;
+static u8 *sCacheRun; // Buffer misses are fetched into, sCacheMaxRun blocks
+static fs_cache_entry *sCacheEntries;
+static u32 *sCacheBuckets;
+static u32 *sCacheFiles; // Per-handle entry lists, sharing sCacheBucketMask
+static u32 sCacheBucketMask;
+static u32 sCacheBlockShift;
+static u32 sCacheMaxRun;
+static u32 sCacheHead, sCacheTail;
+static Handle sCacheRunFd;  // Handle being read into sCacheRun, 0 if none
+static bool sCacheRunStale; // Set if that handle was invalidated during the read
+static archiveCacheStats sCacheStats;
+
+static u32 fsCacheHash(Handle fd, u64 block)
+{
+	u32 h = ((u32)block * 0x9E3779B1U) ^ (u32)(block >> 32) ^ (u32)fd;
+	h *= 0x85EBCA6BU;
+	return (h ^ (h >> 16)) & sCacheBucketMask;
+}
+
+static u32 fsCacheFileHash(Handle fd)
+{
+	u32 h = (u32)fd * 0x9E3779B1U;
+	return (h ^ (h >> 16)) & sCacheBucketMask;
+}
+
+static void fsCacheUnlinkLru(u32 i)
+{
+	fs_cache_entry *e = &sCacheEntries[i];
+	if (e->prev != FS_CACHE_NONE) sCacheEntries[e->prev].next = e->next;
+	else sCacheHead = e->next;
+	if (e->next != FS_CACHE_NONE) sCacheEntries[e->next].prev = e->prev;
+	else sCacheTail = e->prev;
+}
+
+static void fsCacheMoveToFront(u32 i)
+{
+	if (sCacheHead == i)
+		return;
+
+	fsCacheUnlinkLru(i);
+	fs_cache_entry *e = &sCacheEntries[i];
+	e->prev = FS_CACHE_NONE;
+	e->next = sCacheHead;
+	sCacheEntries[sCacheHead].prev = i;
+	sCacheHead = i;
+}
+
+static void fsCacheMoveToBack(u32 i)
+{
+	if (sCacheTail == i)
+		return;
+
+	fsCacheUnlinkLru(i);
+	fs_cache_entry *e = &sCacheEntries[i];
+	e->prev = sCacheTail;
+	e->next = FS_CACHE_NONE;
+	sCacheEntries[sCacheTail].next = i;
+	sCacheTail = i;
+}
+
+static u32 fsCacheFind(Handle fd, u64 block)
+{
+	u32 i = sCacheBuckets[fsCacheHash(fd, block)];
+	while (i != FS_CACHE_NONE && (sCacheEntries[i].fd != fd || sCacheEntries[i].block != block))
+		i = sCacheEntries[i].chain;
+	return i;
+}
+
+static void fsCacheDrop(u32 i)
+{
+	fs_cache_entry *e = &sCacheEntries[i];
+	u32 *link = &sCacheBuckets[fsCacheHash(e->fd, e->block)];
+	while (*link != i)
+		link = &sCacheEntries[*link].chain;
+	*link = e->chain;
+
+	if (e->filePrev != FS_CACHE_NONE) sCacheEntries[e->filePrev].fileNext = e->fileNext;
+	else sCacheFiles[fsCacheFileHash(e->fd)] = e->fileNext;
+	if (e->fileNext != FS_CACHE_NONE) sCacheEntries[e->fileNext].filePrev = e->filePrev;
+
+	e->valid = 0;
+	fsCacheMoveToBack(i);
+}
+
+static void fsCacheStore(Handle fd, u64 block, const u8 *src, u32 valid)
+{
+	if (fsCacheFind(fd, block) != FS_CACHE_NONE)
+		return;
+
+	// Recycle the least recently used entry
+	u32 i = sCacheTail;
+	fs_cache_entry *e = &sCacheEntries[i];
+	if (e->valid)
+		fsCacheDrop(i);
+
+	u32 *bucket = &sCacheBuckets[fsCacheHash(fd, block)];
+	e->fd = fd;
+	e->block = block;
+	e->valid = valid;
+	e->chain = *bucket;
+	*bucket = i;
+
+	u32 *file = &sCacheFiles[fsCacheFileHash(fd)];
+	e->filePrev = FS_CACHE_NONE;
+	e->fileNext = *file;
+	if (*file != FS_CACHE_NONE) sCacheEntries[*file].filePrev = i;
+	*file = i;
+	memcpy(sCacheData + (i << sCacheBlockShift), src, valid);
+	fsCacheMoveToFront(i);
+}
+
+static void fsCacheCount(u32 *counter, u32 amount)
+{
+	__atomic_add_fetch(counter, amount, __ATOMIC_RELAXED);
+}
+
+Result fsCacheRead(Handle fd, fs_cache_stream_t *stream, u64 offset, void *buffer, u32 size, u32 *bytesRead)
+{
+	u8 *out = (u8*)buffer;
+	u32 done = 0;
+	Result rc = 0;
+
+	// Grow the read-ahead window while the file is being streamed, drop it on seeks
+	if (offset != stream->next)
+		stream->window = 0;
+	else if (stream->window < FS_CACHE_MAX_RUN)
+		stream->window = stream->window ? 2*stream->window : 1;
+
+	LightLock_Lock(&sCacheLock);
+	bool bypass = !sCacheData || size >= (sCacheMaxRun << sCacheBlockShift);
+	LightLock_Unlock(&sCacheLock);
+
+	// Large reads are already efficient, and would only flush the cache
+	if (bypass)
+	{
+		rc = FSFILE_Read(fd, &done, offset, buffer, size);
+		stream->next = offset + done;
+		*bytesRead = done;
+		return rc;
+	}
+
+	fsCacheCount(&sCacheStats.requests, 1);
+	while (done < size)
+	{
+		u64 pos = offset + done;
+		u32 remaining = size - done;
+
+		LightLock_Lock(&sCacheLock);
+		if (!sCacheData)
+		{
+			// The cache was torn down halfway through
+			LightLock_Unlock(&sCacheLock);
+			u32 read = 0;
+			rc = FSFILE_Read(fd, &read, pos, out + done, remaining);
+			fsCacheCount(&sCacheStats.fsReads, 1);
+			done += read;
+			break;
+		}
+
+		u32 shift = sCacheBlockShift;
+		u64 block = pos >> shift;
+		u32 within = pos & ((1U << shift) - 1);
+		u32 i = fsCacheFind(fd, block);
+		if (i != FS_CACHE_NONE)
+		{
+			fs_cache_entry *e = &sCacheEntries[i];
+			u32 avail = e->valid > within ? e->valid - within : 0;
+			u32 n = avail < remaining ? avail : remaining;
+			bool eof = e->valid < (1U << shift) && within + n >= e->valid;
+			memcpy(out + done, sCacheData + (i << shift) + within, n);
+			fsCacheMoveToFront(i);
+			LightLock_Unlock(&sCacheLock);
+
+			fsCacheCount(&sCacheStats.hits, 1);
+			done += n;
+			if (eof) break;
+			continue;
+		}
+
+		LightLock_Unlock(&sCacheLock);
+
+		// Misses share the run buffer. Look the block up again once it is ours, as the thread
+		// that held it may have just fetched the block
+		LightLock_Lock(&sCacheRunLock);
+		LightLock_Lock(&sCacheLock);
+		if (!sCacheData || sCacheBlockShift != shift || fsCacheFind(fd, block) != FS_CACHE_NONE)
+		{
+			LightLock_Unlock(&sCacheLock);
+			LightLock_Unlock(&sCacheRunLock);
+			continue;
+		}
+		u32 maxRun = sCacheMaxRun;
+		u8 *runData = sCacheRun;
+		sCacheRunFd = fd;
+		sCacheRunStale = false;
+		LightLock_Unlock(&sCacheLock);
+
+		// Fetch every block the rest of the request needs in one go, plus the read-ahead window
+		u32 need = ((within + remaining - 1) >> shift) + 1;
+		u32 run = need + stream->window;
+		if (run > maxRun) run = maxRun;
+		if (need > run) need = run;
+
+		u32 runSize = run << shift;
+		u32 got = 0;
+		rc = FSFILE_Read(fd, &got, block << shift, runData, runSize);
+		fsCacheCount(&sCacheStats.fsReads, 1);
+		fsCacheCount(&sCacheStats.misses, need);
+		fsCacheCount(&sCacheStats.readAhead, run - need);
+
+		// Don't cache anything if the file was written to while the read was in flight
+		LightLock_Lock(&sCacheLock);
+		if (R_SUCCEEDED(rc) && !sCacheRunStale)
+			for (u32 j = 0; j < run && (j << shift) < got; j ++)
+			{
+				u32 valid = got - (j << shift);
+				if (valid > (1U << shift)) valid = 1U << shift;
+				fsCacheStore(fd, block + j, runData + (j << shift), valid);
+			}
+		sCacheRunFd = 0;
+		LightLock_Unlock(&sCacheLock);
+
+		if (R_FAILED(rc))
+		{
+			LightLock_Unlock(&sCacheRunLock);
+			break;
+		}
+
+		u32 avail = got > within ? got - within : 0;
+		u32 n = avail < remaining ? avail : remaining;
+		memcpy(out + done, runData + within, n);
+		LightLock_Unlock(&sCacheRunLock);
+
+		done += n;
+		if (got < runSize && within + n >= got)
+			break; // End-of-file
+	}
+
+	// Report a short read rather than an error if some data made it through
+	if (R_FAILED(rc) && done)
+		rc = 0;
+
+	stream->next = offset + done;
+	*bytesRead = done;
+	return rc;
+}
+
+void fsCacheInvalidate(Handle fd)
+{
+	LightLock_Lock(&sCacheLock);
+	if (sCacheRunFd == fd)
+		sCacheRunStale = true;
+
+	// Only walk the entries of handles sharing the bucket of this one
+	if (sCacheData)
+		for (u32 i = sCacheFiles[fsCacheFileHash(fd)]; i != FS_CACHE_NONE; )
+		{
+			u32 next = sCacheEntries[i].fileNext;
+			if (sCacheEntries[i].fd == fd)
+				fsCacheDrop(i);
+			i = next;
+		}
+	LightLock_Unlock(&sCacheLock);
+}
+
+Result archiveCacheSetup(u32 blockSize, u32 blockCount)
+{
+	u8 *data = NULL, *runData = NULL;
+	fs_cache_entry *entries = NULL;
+	u32 *buckets = NULL, *files = NULL;
+	u32 bucketCount = 0;
+	u32 maxRun = 1;
+
+	if (blockCount)
+	{
+		if (blockSize < 0x200 || (blockSize & (blockSize - 1)) || blockCount < 2 || blockCount > 0x10000
+			|| blockSize > UINT32_MAX / blockCount)
+			return MAKERESULT(RL_USAGE, RS_INVALIDARG, RM_APPLICATION, RD_INVALID_SIZE);
+
+		// Keep the hash chains short
+		bucketCount = 1U << (32 - __builtin_clz(blockCount - 1));
+
+		// Never let a single stream take over more than a quarter of the cache
+		maxRun = blockCount / 4;
+		if (maxRun < 1) maxRun = 1;
+		if (maxRun > FS_CACHE_MAX_RUN) maxRun = FS_CACHE_MAX_RUN;
+
+		data = (u8*)malloc(blockSize * blockCount);
+		runData = (u8*)malloc(blockSize * maxRun);
+		entries = (fs_cache_entry*)malloc(blockCount * sizeof(fs_cache_entry));
+		buckets = (u32*)malloc(bucketCount * sizeof(u32));
+		files = (u32*)malloc(bucketCount * sizeof(u32));
+		if (!data || !runData || !entries || !buckets || !files)
+		{
+			free(data);
+			free(runData);
+			free(entries);
+			free(buckets);
+			free(files);
+			return MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY);
+		}
+
+		memset(buckets, 0xFF, bucketCount * sizeof(u32));
+		memset(files, 0xFF, bucketCount * sizeof(u32));
+		for (u32 i = 0; i < blockCount; i ++)
+		{
+			entries[i].valid = 0;
+			entries[i].prev = i ? i - 1 : FS_CACHE_NONE;
+			entries[i].next = i + 1 < blockCount ? i + 1 : FS_CACHE_NONE;
+		}
+	}
+
+	// Wait for any miss in flight to be done with the run buffer
+	LightLock_Lock(&sCacheRunLock);
+	LightLock_Lock(&sCacheLock);
+	u8 *oldData = sCacheData;
+	u8 *oldRunData = sCacheRun;
+	fs_cache_entry *oldEntries = sCacheEntries;
+	u32 *oldBuckets = sCacheBuckets;
+	u32 *oldFiles = sCacheFiles;
+
+	sCacheData = data;
+	sCacheRun = runData;
+	sCacheEntries = entries;
+	sCacheBuckets = buckets;
+	sCacheFiles = files;
+	sCacheBucketMask = bucketCount - 1;
+	sCacheBlockShift = blockCount ? __builtin_ctz(blockSize) : 0;
+	sCacheHead = blockCount ? 0 : FS_CACHE_NONE;
+	sCacheTail = blockCount ? blockCount - 1 : FS_CACHE_NONE;
+	sCacheMaxRun = maxRun;
+	LightLock_Unlock(&sCacheLock);
+	LightLock_Unlock(&sCacheRunLock);
+
+	free(oldData);
+	free(oldRunData);
+	free(oldEntries);
+	free(oldBuckets);
+	free(oldFiles);
+	return 0;
+}
+
+void archiveCacheGetStats(archiveCacheStats *out)
+{
+	out->requests  = __atomic_load_n(&sCacheStats.requests, __ATOMIC_RELAXED);
+	out->hits      = __atomic_load_n(&sCacheStats.hits, __ATOMIC_RELAXED);
+	out->misses    = __atomic_load_n(&sCacheStats.misses, __ATOMIC_RELAXED);
+	out->readAhead = __atomic_load_n(&sCacheStats.readAhead, __ATOMIC_RELAXED);
+	out->fsReads   = __atomic_load_n(&sCacheStats.fsReads, __ATOMIC_RELAXED);
+	out->ipcsSaved = out->requests > out->fsReads ? out->requests - out->fsReads : 0;
+}
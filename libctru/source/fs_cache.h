@@ -0,0 +1,12 @@
+#pragma once
+#include <3ds/types.h>
+
+// Per-file state used to detect sequential access and size the read-ahead
+typedef struct
+{
+	u64 next;   // Offset right after the previous read
+	u32 window; // Blocks currently read ahead of a sequential stream
+} fs_cache_stream_t;
+
+Result fsCacheRead(Handle fd, fs_cache_stream_t *stream, u64 offset, void *buffer, u32 size, u32 *bytesRead);
+void fsCacheInvalidate(Handle fd);
@@ -0,0 +1,461 @@
+#include <string.h>
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+#include <3ds/synchronization.h>
+#include <3ds/thread.h>
+#include <3ds/jobs.h>
+
+#define JOBS_EXTERNAL    JOBS_MAX_WORKERS       // Queue shared by the threads which are not workers
+#define JOBS_QUEUE_COUNT (JOBS_MAX_WORKERS + 1)
+#define JOBS_SPIN_COUNT  64                     // Empty scans before a worker goes to sleep
+#define JOBS_ABORT       ((Job*)1)              // A steal lost a race, the queue may still hold jobs
+
+// Chase-Lev deque: the owner pushes and pops at the bottom, other threads steal from the top.
+typedef struct
+{
+	u32 top __attribute__((aligned(32)));
+	u32 bottom __attribute__((aligned(32)));
+	Job* slots[JOBS_QUEUE_SIZE];
+} JobQueue;
+
+typedef struct
+{
+	u32 next;
+	u32 end;
+	u32 grain;
+	JobRangeFunc func;
+	void* arg;
+} JobRange;
+
+static int jobsRefCount;
+static JobQueue jobsQueues[JOBS_QUEUE_COUNT];
+static LightLock jobsExternalLock = 1;
+static Thread jobsThreads[JOBS_MAX_WORKERS];
+static u32 jobsThreadCount;
+static bool jobsRunning;
+static s32 jobsSleepers; // Workers about to sleep or sleeping
+static s32 jobsTokens;   // Wake-ups handed out to sleeping workers
+
+static __thread JobQueue* jobsLocalQueue; // NULL outside of worker threads
+
+static bool jobsQueuePush(JobQueue* q, Job* job)
+{
+	u32 b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED);
+	u32 t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+	if (b - t >= JOBS_QUEUE_SIZE)
+		return false;
+
+	__atomic_store_n(&q->slots[b % JOBS_QUEUE_SIZE], job, __ATOMIC_RELAXED);
+	__atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static Job* jobsQueuePop(JobQueue* q)
+{
+	u32 b = __atomic_load_n(&q->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&q->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	u32 t = __atomic_load_n(&q->top, __ATOMIC_RELAXED);
+
+	if ((s32)(b - t) < 0)
+	{
+		__atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	Job* job = __atomic_load_n(&q->slots[b % JOBS_QUEUE_SIZE], __ATOMIC_RELAXED);
+	if (b == t)
+	{
+		// Last job, thieves may be going for it as well
+		if (!__atomic_compare_exchange_n(&q->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+			job = NULL;
+		__atomic_store_n(&q->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+
+	return job;
+}
+
+static Job* jobsQueueSteal(JobQueue* q)
+{
+	u32 t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	u32 b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+	if ((s32)(b - t) <= 0)
+		return NULL;
+
+	Job* job = __atomic_load_n(&q->slots[t % JOBS_QUEUE_SIZE], __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&q->top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return JOBS_ABORT;
+
+	return job;
+}
+
+static bool jobsQueueIsEmpty(JobQueue* q)
+{
+	u32 t = __atomic_load_n(&q->top, __ATOMIC_ACQUIRE);
+	u32 b = __atomic_load_n(&q->bottom, __ATOMIC_ACQUIRE);
+	return (s32)(b - t) <= 0;
+}
+
+static bool jobsAnyQueued(void)
+{
+	for (u32 i = 0; i < JOBS_QUEUE_COUNT; i ++)
+		if (!jobsQueueIsEmpty(&jobsQueues[i]))
+			return true;
+	return false;
+}
+
+static bool jobsPush(Job* job)
+{
+	JobQueue* q = jobsLocalQueue;
+	if (q)
+		return jobsQueuePush(q, job);
+
+	// Threads other than the workers take turns owning the shared queue
+	LightLock_Lock(&jobsExternalLock);
+	bool ok = jobsQueuePush(&jobsQueues[JOBS_EXTERNAL], job);
+	LightLock_Unlock(&jobsExternalLock);
+	return ok;
+}
+
+static Job* jobsFind(void)
+{
+	JobQueue* own = jobsLocalQueue;
+	JobQueue* ext = &jobsQueues[JOBS_EXTERNAL];
+	Job* job = NULL;
+
+	if (own)
+		job = jobsQueuePop(own);
+	else if (!jobsQueueIsEmpty(ext))
+	{
+		LightLock_Lock(&jobsExternalLock);
+		job = jobsQueuePop(ext);
+		LightLock_Unlock(&jobsExternalLock);
+	}
+
+	if (job)
+		return job;
+
+	// Start stealing right after our own queue, so that thieves spread out
+	u32 start = own ? (u32)(own - jobsQueues) + 1 : 0;
+	bool retry;
+	do
+	{
+		retry = false;
+		for (u32 i = 0; i < JOBS_QUEUE_COUNT; i ++)
+		{
+			JobQueue* q = &jobsQueues[(start + i) % JOBS_QUEUE_COUNT];
+			if (q == own)
+				continue;
+
+			job = jobsQueueSteal(q);
+			if (job == JOBS_ABORT)
+				retry = true;
+			else if (job)
+				return job;
+		}
+	} while (retry);
+
+	return NULL;
+}
+
+static void jobsWake(u32 count)
+{
+	// Pairs with the barrier between announcing a sleeper and scanning the queues
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	s32 n = __atomic_load_n(&jobsSleepers, __ATOMIC_RELAXED) - __atomic_load_n(&jobsTokens, __ATOMIC_RELAXED);
+	if (n <= 0)
+		return;
+
+	if ((u32)n > count)
+		n = count;
+	__atomic_add_fetch(&jobsTokens, n, __ATOMIC_SEQ_CST);
+	syncArbitrateAddress(&jobsTokens, ARBITRATION_SIGNAL, n);
+}
+
+static void jobsSleep(void)
+{
+	// New jobs often follow shortly, so keep looking for a bit before sleeping
+	for (u32 i = 0; i < JOBS_SPIN_COUNT; i ++)
+		if (jobsAnyQueued())
+			return;
+
+	AtomicIncrement(&jobsSleepers);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (!jobsAnyQueued() && __atomic_load_n(&jobsRunning, __ATOMIC_RELAXED))
+	{
+		for (;;)
+		{
+			s32 tokens = __atomic_load_n(&jobsTokens, __ATOMIC_RELAXED);
+			if (tokens > 0)
+			{
+				if (__atomic_compare_exchange_n(&jobsTokens, &tokens, tokens - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+					break;
+				continue;
+			}
+
+			syncArbitrateAddress(&jobsTokens, ARBITRATION_WAIT_IF_LESS_THAN, 1);
+		}
+	}
+
+	AtomicDecrement(&jobsSleepers);
+}
+
+static bool jobsHoldBack(Job* job)
+{
+	JobCounter* dep = job->dependency;
+
+	// The counter only reaches zero with its lock held, see jobsCounterRelease
+	LightLock_Lock(&dep->lock);
+	bool held = __atomic_load_n(&dep->value, __ATOMIC_ACQUIRE) != 0;
+	if (held)
+	{
+		job->next = dep->dependents;
+		dep->dependents = job;
+	}
+	LightLock_Unlock(&dep->lock);
+
+	return held;
+}
+
+static void jobsRun(Job* job);
+
+static void jobsQueueBatch(Job* job)
+{
+	u32 queued = 0;
+	while (job)
+	{
+		Job* next = job->next;
+		if (jobsPush(job))
+			queued ++;
+		else
+			jobsRun(job);
+		job = next;
+	}
+
+	if (queued)
+		jobsWake(queued);
+}
+
+static void jobsCounterRelease(JobCounter* counter)
+{
+	s32 value = __atomic_load_n(&counter->value, __ATOMIC_RELAXED);
+	while (value > 1)
+		if (__atomic_compare_exchange_n(&counter->value, &value, value - 1, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			return;
+
+	// Last job: release the dependents and wake the waiters
+	Job* dependents = NULL;
+	LightLock_Lock(&counter->lock);
+	if (AtomicDecrement(&counter->value) == 0)
+	{
+		dependents = counter->dependents;
+		counter->dependents = NULL;
+		if (__atomic_load_n(&counter->wait, __ATOMIC_RELAXED) == 0)
+		{
+			__atomic_store_n(&counter->wait, 1, __ATOMIC_RELAXED);
+			syncArbitrateAddress(&counter->wait, ARBITRATION_SIGNAL, -1);
+		}
+	}
+	LightLock_Unlock(&counter->lock);
+
+	jobsQueueBatch(dependents);
+}
+
+static void jobsRun(Job* job)
+{
+	// The job may be reused as soon as it starts running
+	JobCounter* counter = job->counter;
+	job->func(job->arg);
+	if (counter)
+		jobsCounterRelease(counter);
+}
+
+static void jobsThreadMain(void* arg)
+{
+	jobsLocalQueue = (JobQueue*)arg;
+
+	for (;;)
+	{
+		Job* job = jobsFind();
+		if (job)
+		{
+			jobsRun(job);
+			continue;
+		}
+
+		// Only quit once the queues are drained
+		if (!__atomic_load_n(&jobsRunning, __ATOMIC_ACQUIRE))
+			break;
+
+		jobsSleep();
+	}
+}
+
+Result jobsInit(u32 coreMask, int priority, size_t stackSize)
+{
+	if (AtomicPostIncrement(&jobsRefCount)) return 0;
+
+	__atomic_store_n(&jobsRunning, true, __ATOMIC_RELAXED);
+	for (int core = 0; core < JOBS_MAX_WORKERS; core ++)
+	{
+		if (!(coreMask & BIT(core)))
+			continue;
+
+		// Creating the thread fails on processors the application may not use
+		Thread thread = threadCreate(jobsThreadMain, &jobsQueues[jobsThreadCount], stackSize, priority, core, false);
+		if (thread)
+			jobsThreads[jobsThreadCount ++] = thread;
+	}
+
+	if (!jobsThreadCount)
+	{
+		jobsRunning = false;
+		AtomicDecrement(&jobsRefCount);
+		return MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_APPLICATION, RD_OUT_OF_MEMORY);
+	}
+
+	return 0;
+}
+
+void jobsExit(void)
+{
+	if (AtomicDecrement(&jobsRefCount)) return;
+
+	__atomic_store_n(&jobsRunning, false, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&jobsTokens, jobsThreadCount, __ATOMIC_SEQ_CST);
+	syncArbitrateAddress(&jobsTokens, ARBITRATION_SIGNAL, -1);
+
+	for (u32 i = 0; i < jobsThreadCount; i ++)
+	{
+		threadJoin(jobsThreads[i], U64_MAX);
+		threadFree(jobsThreads[i]);
+	}
+	jobsThreadCount = 0;
+	jobsTokens = 0;
+}
+
+u32 jobsGetWorkerCount(void)
+{
+	return jobsThreadCount;
+}
+
+void jobsCounterInit(JobCounter* counter)
+{
+	counter->value = 0;
+	counter->wait = 1;
+	LightLock_Init(&counter->lock);
+	counter->dependents = NULL;
+}
+
+void jobsSubmit(Job* jobs, u32 count)
+{
+	// Count every job first, so that a group never looks finished halfway through the batch
+	for (u32 i = 0; i < count; i ++)
+		if (jobs[i].counter)
+			AtomicIncrement(&jobs[i].counter->value);
+
+	Job* ready = NULL;
+	for (u32 i = count; i --; )
+	{
+		Job* job = &jobs[i];
+		if (job->dependency && jobsHoldBack(job))
+			continue;
+		job->next = ready;
+		ready = job;
+	}
+
+	jobsQueueBatch(ready);
+}
+
+bool jobsIsDone(const JobCounter* counter)
+{
+	return __atomic_load_n(&counter->value, __ATOMIC_ACQUIRE) == 0;
+}
+
+void jobsWait(JobCounter* counter)
+{
+	while (!jobsIsDone(counter))
+	{
+		Job* job = jobsFind();
+		if (!job)
+		{
+			__atomic_store_n(&counter->wait, 0, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_SEQ_CST);
+			if (jobsIsDone(counter))
+				break;
+
+			// The remaining jobs are running elsewhere or held back by dependencies
+			job = jobsFind();
+			if (!job)
+			{
+				syncArbitrateAddress(&counter->wait, ARBITRATION_WAIT_IF_LESS_THAN, 1);
+				continue;
+			}
+		}
+
+		jobsRun(job);
+	}
+
+	// Let the thread which finished the last job let go of the counter
+	LightLock_Lock(&counter->lock);
+	LightLock_Unlock(&counter->lock);
+}
+
+static void jobsRangeRun(void* arg)
+{
+	JobRange* range = (JobRange*)arg;
+	u32 begin = __atomic_load_n(&range->next, __ATOMIC_RELAXED);
+
+	while (begin < range->end)
+	{
+		u32 end = range->end - begin > range->grain ? begin + range->grain : range->end;
+		if (!__atomic_compare_exchange_n(&range->next, &begin, end, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			continue;
+
+		range->func(begin, end, range->arg);
+		begin = __atomic_load_n(&range->next, __ATOMIC_RELAXED);
+	}
+}
+
+void ctruParallelFor(u32 begin, u32 end, u32 grain, JobRangeFunc func, void* arg)
+{
+	if (begin >= end)
+		return;
+
+	// By default, split the range into a few chunks per thread to even out uneven chunks
+	u32 len = end - begin;
+	u32 workers = jobsThreadCount;
+	if (!grain)
+		grain = len / ((workers + 1) * 8);
+	if (!grain)
+		grain = 1;
+
+	u32 chunks = (len - 1) / grain + 1;
+	u32 helpers = chunks - 1 < workers ? chunks - 1 : workers;
+	if (!helpers)
+	{
+		func(begin, end, arg);
+		return;
+	}
+
+	JobRange range = { begin, end, grain, func, arg };
+	JobCounter counter;
+	Job jobs[JOBS_MAX_WORKERS];
+
+	jobsCounterInit(&counter);
+	memset(jobs, 0, sizeof(jobs));
+	for (u32 i = 0; i < helpers; i ++)
+	{
+		jobs[i].func = jobsRangeRun;
+		jobs[i].arg = &range;
+		jobs[i].counter = &counter;
+	}
+
+	jobsSubmit(jobs, helpers);
+	jobsRangeRun(&range);
+	jobsWait(&counter);
+}
@@ -17,6 +17,7 @@
 #include <3ds/env.h>
 
 #include "path_buf.h"
+#include "fs_cache.h"
 
 typedef struct romfs_mount
 {
@@ -29,6 +30,11 @@ typedef struct romfs_mount
 	romfs_dir          *cwd;
 	u32                *dirHashTable, *fileHashTable;
 	void               *dirTable, *fileTable;
+	u8                 *data;
+	u32                *dataLoaded;
+	u64                dataSize;
+	struct romfs_index *index;
+	bool               indexLazy;
 	struct romfs_mount *next;
 } romfs_mount;
 
@@ -42,6 +48,29 @@ extern char** __system_argv;
 #define romFS_dir_mode  (S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH)
 #define romFS_file_mode (S_IFREG | S_IRUSR | S_IRGRP | S_IROTH)
 
+// Granularity of lazily loaded file data
+#define ROMFS_DATA_BLOCK_SHIFT 16
+
+// Full path index: an open-addressing hash table (linear probing) mapping the
+// FNV-1a hash of every absolute UTF-8 path to its file or directory entry.
+// Paths are not stored, hits are verified against the entry names instead.
+#define ROMFS_INDEX_DIR   0x80000000
+#define ROMFS_FNV_OFFSET  0x811C9DC5
+#define ROMFS_FNV_PRIME   0x01000193
+
+typedef struct
+{
+	u32 hash;
+	u32 entry; // Offset into the file table, or into the directory table with ROMFS_INDEX_DIR set
+} romfs_index_slot;
+
+typedef struct romfs_index
+{
+	u32              bits;
+	u32              count;
+	romfs_index_slot slots[];
+} romfs_index;
+
 static ssize_t _romfs_read(romfs_mount *mount, u64 offset, void* buffer, u32 size)
 {
 	u64 pos = (u64)mount->offset + offset;
@@ -57,6 +86,46 @@ static bool _romfs_read_chk(romfs_mount *mount, u64 offset, void* buffer, u32 si
 	return res >= 0 && (u32)res == size;
 }
 
+static bool _romfs_data_loaded(romfs_mount *mount, u32 block)
+{
+	return (__atomic_load_n(&mount->dataLoaded[block/32], __ATOMIC_ACQUIRE) >> (block%32)) & 1;
+}
+
+static bool _romfs_data_load(romfs_mount *mount, u64 offset, u64 size)
+{
+	// Nothing to do if the data region was loaded up front
+	if (!mount->dataLoaded || !size)
+		return true;
+
+	// Bring in every missing block covering the range, merging runs of missing blocks into single reads
+	u32 block = offset >> ROMFS_DATA_BLOCK_SHIFT;
+	u32 lastBlock = (offset + size - 1) >> ROMFS_DATA_BLOCK_SHIFT;
+	while (block <= lastBlock)
+	{
+		if (_romfs_data_loaded(mount, block))
+		{
+			block++;
+			continue;
+		}
+
+		u32 endBlock = block + 1;
+		while (endBlock <= lastBlock && !_romfs_data_loaded(mount, endBlock))
+			endBlock++;
+
+		u64 start = (u64)block << ROMFS_DATA_BLOCK_SHIFT;
+		u64 end   = (u64)endBlock << ROMFS_DATA_BLOCK_SHIFT;
+		if (end > mount->dataSize)
+			end = mount->dataSize;
+		if (!_romfs_read_chk(mount, mount->header.fileDataOff + start, mount->data + start, end - start))
+			return false;
+
+		for (; block < endBlock; block++)
+			__atomic_fetch_or(&mount->dataLoaded[block/32], 1U << (block%32), __ATOMIC_RELEASE);
+	}
+
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 
 static int       romfs_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode);
@@ -73,9 +142,10 @@ static int       romfs_dirclose(struct _reent *r, DIR_ITER *dirState);
 
 typedef struct
 {
-	romfs_mount *mount;
-	romfs_file  *file;
-	u64         offset, pos;
+	romfs_mount       *mount;
+	romfs_file        *file;
+	u64               offset, pos;
+	fs_cache_stream_t stream;
 } romfs_fileobj;
 
 typedef struct
@@ -163,10 +233,26 @@ static romfs_mount* romfs_alloc(void)
 	return mount;
 }
 
+static romfs_mount* romfs_find(const char *name)
+{
+	romfs_mount* mount = romfs_mount_list;
+	while (mount)
+	{
+		if (strncmp(mount->name, name, sizeof(mount->name)) == 0)
+			break;
+		mount = mount->next;
+	}
+	return mount;
+}
+
 static void romfs_free(romfs_mount *mount)
 {
+	fsCacheInvalidate(mount->fd);
 	FSFILE_Close(mount->fd);
 	romfs_remove(mount);
+	free(mount->data);
+	free(mount->dataLoaded);
+	free(mount->index);
 	free(mount->fileTable);
 	free(mount->fileHashTable);
 	free(mount->dirTable);
@@ -329,14 +415,7 @@ Result romfsMountFromTitle(u64 tid, FS_MediaType mediatype, const char* name)
 Result romfsUnmount(const char* name)
 {
 	// Find the mount
-	romfs_mount* mount = romfs_mount_list;
-	while (mount)
-	{
-		if (strncmp(mount->name, name, sizeof(mount->name)) == 0)
-			break;
-		mount = mount->next;
-	}
-
+	romfs_mount* mount = romfs_find(name);
 	if (mount == NULL)
 		return MAKERESULT(RL_STATUS, RS_NOTFOUND, RM_ROMFS, RD_NOT_FOUND);
 
@@ -354,6 +433,60 @@ Result romfsUnmount(const char* name)
 	return 0;
 }
 
+Result romfsSetDataMode(const char *name, RomfsDataMode mode)
+{
+	romfs_mount* mount = romfs_find(name);
+	if (mount == NULL)
+		return MAKERESULT(RL_STATUS, RS_NOTFOUND, RM_ROMFS, RD_NOT_FOUND);
+
+	// Drop the current in-memory copy of the file data, if any
+	free(mount->data);
+	free(mount->dataLoaded);
+	mount->data       = NULL;
+	mount->dataLoaded = NULL;
+	mount->dataSize   = 0;
+
+	if (mode == ROMFS_DATA_STREAM)
+		return 0;
+
+	// The file data region ends with the data of the last file
+	u64 dataSize = 0;
+	u32 off = 0;
+	while (off + sizeof(romfs_file) <= mount->header.fileTableSize)
+	{
+		romfs_file* file = romFS_file(mount, off);
+		if (file->dataOff + file->dataSize > dataSize)
+			dataSize = file->dataOff + file->dataSize;
+		off += sizeof(romfs_file) + ((file->nameLen + 3) &~ 3);
+	}
+
+	if (dataSize > SIZE_MAX)
+		return MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_ROMFS, RD_OUT_OF_MEMORY);
+
+	u8* data = (u8*)malloc(dataSize ? dataSize : 1);
+	if (!data)
+		return MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_ROMFS, RD_OUT_OF_MEMORY);
+
+	if (mode == ROMFS_DATA_LAZY)
+	{
+		u32 numBlocks = (dataSize + (1U << ROMFS_DATA_BLOCK_SHIFT) - 1) >> ROMFS_DATA_BLOCK_SHIFT;
+		mount->dataLoaded = (u32*)calloc((numBlocks + 31) / 32 + 1, sizeof(u32));
+		if (!mount->dataLoaded)
+		{
+			free(data);
+			return MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_ROMFS, RD_OUT_OF_MEMORY);
+		}
+	} else if (dataSize && !_romfs_read_chk(mount, mount->header.fileDataOff, data, dataSize))
+	{
+		free(data);
+		return MAKERESULT(RL_FATAL, RS_INVALIDSTATE, RM_ROMFS, RD_NOT_FOUND);
+	}
+
+	mount->dataSize = dataSize;
+	mount->data     = data;
+	return 0;
+}
+
 //-----------------------------------------------------------------------------
 
 static u32 calcHash(u32 parent, u16* name, u32 namelen, u32 total)
@@ -402,6 +535,217 @@ static romfs_file* searchForFile(romfs_mount *mount, romfs_dir* parent, u16* nam
 	return NULL;
 }
 
+static u32 _romfs_index_hash_name(u32 hash, const u16* name, u32 nameLen)
+{
+	u32 units = nameLen / 2;
+	hash = (hash ^ '/') * ROMFS_FNV_PRIME;
+	for (u32 i = 0; i < units;)
+	{
+		// Don't let a truncated surrogate pair read past the name
+		if ((name[i] & 0xFC00) == 0xD800 && i + 1 >= units)
+			break;
+
+		uint32_t code;
+		uint8_t  enc[4];
+		ssize_t  n = decode_utf16(&code, name + i);
+		if (n <= 0)
+			break;
+		i += n;
+
+		n = encode_utf8(enc, code);
+		for (ssize_t j = 0; j < n; j ++)
+			hash = (hash ^ enc[j]) * ROMFS_FNV_PRIME;
+	}
+	return hash;
+}
+
+static bool _romfs_name_eq(const u16* name, u32 nameLen, const char* str, u32 len)
+{
+	u32 units = nameLen / 2, i = 0;
+	const uint8_t* p = (const uint8_t*)str, *end = p + len;
+	while (p < end)
+	{
+		uint32_t code;
+		uint16_t enc[2];
+		ssize_t  n = decode_utf8(&code, p);
+		if (n <= 0 || n > end - p)
+			return false;
+		p += n;
+
+		n = encode_utf16(enc, code);
+		if (n <= 0 || i + n > units)
+			return false;
+		if (name[i] != enc[0] || (n > 1 && name[i+1] != enc[1]))
+			return false;
+		i += n;
+	}
+	return i == units;
+}
+
+static void _romfs_index_insert(romfs_index* index, u32 hash, u32 entry)
+{
+	u32 mask = (1U << index->bits) - 1;
+	u32 i = (hash * 0x9E3779B1U) >> (32 - index->bits);
+	while (index->slots[i].entry != romFS_none)
+		i = (i + 1) & mask;
+	index->slots[i].hash  = hash;
+	index->slots[i].entry = entry;
+	index->count ++;
+}
+
+static void _romfs_index_add_dir(romfs_mount *mount, romfs_index* index, u32 capacity, romfs_dir* dir, u32 hash, u32 depth)
+{
+	// Stay within bounds even if the directory tree is corrupted
+	if (depth > PATH_MAX/2)
+		return;
+
+	u32 off;
+	for (off = dir->childFile; off != romFS_none && index->count < capacity;)
+	{
+		romfs_file* file = romFS_file(mount, off);
+		_romfs_index_insert(index, _romfs_index_hash_name(hash, file->name, file->nameLen), off);
+		off = file->sibling;
+	}
+
+	for (off = dir->childDir; off != romFS_none && index->count < capacity;)
+	{
+		romfs_dir* child = romFS_dir(mount, off);
+		u32 childHash = _romfs_index_hash_name(hash, child->name, child->nameLen);
+		_romfs_index_insert(index, childHash, off | ROMFS_INDEX_DIR);
+		_romfs_index_add_dir(mount, index, capacity, child, childHash, depth + 1);
+		off = child->sibling;
+	}
+}
+
+static romfs_index* _romfs_index_build(romfs_mount *mount)
+{
+	// Count every entry but the root directory
+	u32 count = 0, off;
+	for (off = 0; off + sizeof(romfs_dir) <= mount->header.dirTableSize; count ++)
+		off += sizeof(romfs_dir) + ((romFS_dir(mount, off)->nameLen + 3) &~ 3);
+	if (count) count --;
+	for (off = 0; off + sizeof(romfs_file) <= mount->header.fileTableSize; count ++)
+		off += sizeof(romfs_file) + ((romFS_file(mount, off)->nameLen + 3) &~ 3);
+
+	// Keep the load factor at or below 3/4
+	u32 bits = 4;
+	while (count * 4 > (3U << bits))
+		bits ++;
+
+	romfs_index* index = (romfs_index*)malloc(sizeof(romfs_index) + (sizeof(romfs_index_slot) << bits));
+	if (!index)
+		return NULL;
+
+	index->bits  = bits;
+	index->count = 0;
+	memset(index->slots, 0xFF, sizeof(romfs_index_slot) << bits);
+	_romfs_index_add_dir(mount, index, count, romFS_root(mount), ROMFS_FNV_OFFSET, 0);
+	return index;
+}
+
+static romfs_index* _romfs_index_get(romfs_mount *mount)
+{
+	romfs_index* index = __atomic_load_n(&mount->index, __ATOMIC_ACQUIRE);
+	if (index || !mount->indexLazy)
+		return index;
+
+	// Build the index on first use; if another thread got there first, use theirs
+	romfs_index* expected = NULL;
+	index = _romfs_index_build(mount);
+	if (index && !__atomic_compare_exchange_n(&mount->index, &expected, index, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		free(index);
+		index = expected;
+	}
+	return index;
+}
+
+static bool _romfs_index_match(romfs_mount *mount, u32 entry, const char* path, u32 len)
+{
+	u32 parent, nameLen;
+	const u16* name;
+	if (entry & ROMFS_INDEX_DIR)
+	{
+		romfs_dir* dir = romFS_dir(mount, entry &~ ROMFS_INDEX_DIR);
+		parent = dir->parent, name = dir->name, nameLen = dir->nameLen;
+	} else
+	{
+		romfs_file* file = romFS_file(mount, entry);
+		parent = file->parent, name = file->name, nameLen = file->nameLen;
+	}
+
+	// Match the path components from last to first against the chain of parents
+	for (;;)
+	{
+		u32 start = len;
+		while (start && path[start-1] != '/')
+			start --;
+		if (!_romfs_name_eq(name, nameLen, path + start, len - start))
+			return false;
+		if (parent == 0)
+			return start == 0;
+		if (start == 0)
+			return false;
+
+		len = start - 1;
+		romfs_dir* dir = romFS_dir(mount, parent);
+		parent = dir->parent, name = dir->name, nameLen = dir->nameLen;
+	}
+}
+
+// Resolves a path through the path index. Returns false whenever the regular lookup
+// needs to run instead: no index, relative or non-canonical paths, or no match.
+static bool _romfs_index_lookup(romfs_mount *mount, const char* path, romfs_dir** ppDir, romfs_file** ppFile)
+{
+	romfs_index* index = _romfs_index_get(mount);
+	if (!index)
+		return false;
+
+	const char* colonPos = strchr(path, ':');
+	if (colonPos) path = colonPos+1;
+	if (*path == '/')
+		path++;
+	else if (mount->cwd != romFS_root(mount))
+		return false;
+
+	// Hash the path while making sure it has no empty, "." or ".." components
+	u32 hash = (ROMFS_FNV_OFFSET ^ '/') * ROMFS_FNV_PRIME;
+	bool compStart = true;
+	u32 len;
+	for (len = 0; path[len]; len ++)
+	{
+		char c = path[len];
+		if (compStart && (c == '/' || (c == '.' && (path[len+1] == '/' || !path[len+1]
+			|| (path[len+1] == '.' && (path[len+2] == '/' || !path[len+2]))))))
+			return false;
+		compStart = c == '/';
+		hash = (hash ^ (u8)c) * ROMFS_FNV_PRIME;
+	}
+	if (compStart || len > PATH_MAX)
+		return false;
+
+	u32 mask = (1U << index->bits) - 1;
+	for (u32 i = (hash * 0x9E3779B1U) >> (32 - index->bits);; i = (i + 1) & mask)
+	{
+		romfs_index_slot* slot = &index->slots[i];
+		if (slot->entry == romFS_none)
+			return false;
+		if (slot->hash != hash || !_romfs_index_match(mount, slot->entry, path, len))
+			continue;
+
+		if (slot->entry & ROMFS_INDEX_DIR)
+		{
+			if (!ppDir) return false;
+			*ppDir = romFS_dir(mount, slot->entry &~ ROMFS_INDEX_DIR);
+		} else
+		{
+			if (!ppFile) return false;
+			*ppFile = romFS_file(mount, slot->entry);
+		}
+		return true;
+	}
+}
+
 static int navigateToDir(romfs_mount *mount, romfs_dir** ppDir, const char** pPath, bool isDir)
 {
 	ssize_t units;
@@ -465,6 +809,29 @@ static int navigateToDir(romfs_mount *mount, romfs_dir** ppDir, const char** pPa
 	return 0;
 }
 
+static int lookupFile(romfs_mount *mount, romfs_file** ppFile, const char* path)
+{
+	if (_romfs_index_lookup(mount, path, NULL, ppFile))
+		return 0;
+
+	romfs_dir* curDir = NULL;
+	int err = navigateToDir(mount, &curDir, &path, false);
+	if (err != 0)
+		return err;
+
+	ssize_t units = utf8_to_utf16(__ctru_dev_utf16_buf, (const uint8_t*)path, PATH_MAX);
+	if (units <= 0)
+		return EILSEQ;
+	if (units >= PATH_MAX)
+		return ENAMETOOLONG;
+
+	*ppFile = searchForFile(mount, curDir, __ctru_dev_utf16_buf, units);
+	if (!*ppFile)
+		return ENOENT;
+
+	return 0;
+}
+
 static ino_t dir_inode(romfs_mount *mount, romfs_dir *dir)
 {
 	return (uint32_t*)dir - (uint32_t*)mount->dirTable;
@@ -527,6 +894,82 @@ static void fill_file(struct stat *st, romfs_mount *mount, romfs_file *file)
 	st->st_atime   = st->st_mtime = st->st_ctime = mount->mtime;
 }
 
+static romfs_mount* romfs_find_path(const char *path)
+{
+	// Find the mount the path refers to
+	const devoptab_t* dev = GetDeviceOpTab(path);
+	romfs_mount* mount = romfs_mount_list;
+	while (mount && &mount->device != dev)
+		mount = mount->next;
+	return mount;
+}
+
+Result romfsGetFilePointer(const char *path, const void **ptr, size_t *size)
+{
+	romfs_mount* mount = romfs_find_path(path);
+	if (mount == NULL)
+		return MAKERESULT(RL_USAGE, RS_INVALIDARG, RM_ROMFS, RD_NOT_FOUND);
+
+	if (!mount->data)
+		return MAKERESULT(RL_USAGE, RS_INVALIDSTATE, RM_ROMFS, RD_NOT_INITIALIZED);
+
+	romfs_file* file = NULL;
+	if (lookupFile(mount, &file, path) != 0)
+		return MAKERESULT(RL_STATUS, RS_NOTFOUND, RM_ROMFS, RD_NOT_FOUND);
+
+	if (!_romfs_data_load(mount, file->dataOff, file->dataSize))
+		return MAKERESULT(RL_FATAL, RS_INVALIDSTATE, RM_ROMFS, RD_NOT_FOUND);
+
+	*ptr  = mount->data + file->dataOff;
+	*size = file->dataSize;
+	return 0;
+}
+
+Result romfsGetFileLocation(const char *path, Handle *fd, u64 *offset, u64 *size)
+{
+	romfs_mount* mount = romfs_find_path(path);
+	if (mount == NULL)
+		return MAKERESULT(RL_USAGE, RS_INVALIDARG, RM_ROMFS, RD_NOT_FOUND);
+
+	romfs_file* file = NULL;
+	if (lookupFile(mount, &file, path) != 0)
+		return MAKERESULT(RL_STATUS, RS_NOTFOUND, RM_ROMFS, RD_NOT_FOUND);
+
+	*fd     = mount->fd;
+	*offset = (u64)mount->offset + mount->header.fileDataOff + file->dataOff;
+	*size   = file->dataSize;
+	return 0;
+}
+
+Result romfsSetPathIndex(const char *name, RomfsIndexMode mode)
+{
+	romfs_mount* mount = romfs_find(name);
+	if (mount == NULL)
+		return MAKERESULT(RL_STATUS, RS_NOTFOUND, RM_ROMFS, RD_NOT_FOUND);
+
+	free(mount->index);
+	mount->index     = NULL;
+	mount->indexLazy = mode == ROMFS_INDEX_LAZY;
+
+	if (mode == ROMFS_INDEX_EAGER)
+	{
+		mount->index = _romfs_index_build(mount);
+		if (!mount->index)
+			return MAKERESULT(RL_FATAL, RS_OUTOFRESOURCE, RM_ROMFS, RD_OUT_OF_MEMORY);
+	}
+
+	return 0;
+}
+
+size_t romfsGetPathIndexSize(const char *name)
+{
+	romfs_mount* mount = romfs_find(name);
+	if (mount == NULL || mount->index == NULL)
+		return 0;
+
+	return sizeof(romfs_index) + (sizeof(romfs_index_slot) << mount->index->bits);
+}
+
 //-----------------------------------------------------------------------------
 
 int romfs_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode)
@@ -541,33 +984,13 @@ int romfs_open(struct _reent *r, void *fileStruct, const char *path, int flags,
 		return -1;
 	}
 
-	romfs_dir* curDir = NULL;
-	r->_errno = navigateToDir(fileobj->mount, &curDir, &path, false);
+	romfs_file* file = NULL;
+	r->_errno = lookupFile(fileobj->mount, &file, path);
+	if (r->_errno == ENOENT && (flags & O_CREAT))
+		r->_errno = EROFS;
 	if (r->_errno != 0)
 		return -1;
-
-	ssize_t units = utf8_to_utf16(__ctru_dev_utf16_buf, (const uint8_t*)path, PATH_MAX);
-	if (units <= 0)
-	{
-		r->_errno = EILSEQ;
-		return -1;
-	}
-	if (units >= PATH_MAX)
-	{
-		r->_errno = ENAMETOOLONG;
-		return -1;
-	}
-
-	romfs_file* file = searchForFile(fileobj->mount, curDir, __ctru_dev_utf16_buf, units);
-	if (!file)
-	{
-		if(flags & O_CREAT)
-			r->_errno = EROFS;
-		else
-			r->_errno = ENOENT;
-		return -1;
-	}
-	else if((flags & O_CREAT) && (flags & O_EXCL))
+	if((flags & O_CREAT) && (flags & O_EXCL))
 	{
 		r->_errno = EEXIST;
 		return -1;
@@ -577,6 +1000,9 @@ int romfs_open(struct _reent *r, void *fileStruct, const char *path, int flags,
 	fileobj->offset = (u64)fileobj->mount->header.fileDataOff + file->dataOff;
 	fileobj->pos    = 0;
 
+	fileobj->stream.next   = fileobj->mount->offset + fileobj->offset;
+	fileobj->stream.window = 0;
+
 	return 0;
 }
 
@@ -599,8 +1025,25 @@ ssize_t romfs_read(struct _reent *r, void *fd, char *ptr, size_t len)
 		endPos = file->file->dataSize;
 	len = endPos - file->pos;
 
-	ssize_t adv = _romfs_read(file->mount, file->offset + file->pos, ptr, len);
-	if(adv >= 0)
+	romfs_mount* mount = file->mount;
+	if(mount->data)
+	{
+		/* serve the read from memory */
+		u64 dataPos = file->file->dataOff + file->pos;
+		if(!_romfs_data_load(mount, dataPos, len))
+		{
+			r->_errno = EIO;
+			return -1;
+		}
+
+		memcpy(ptr, mount->data + dataPos, len);
+		file->pos += len;
+		return len;
+	}
+
+	u32 adv = 0;
+	Result rc = fsCacheRead(mount->fd, &file->stream, (u64)mount->offset + file->offset + file->pos, ptr, len, &adv);
+	if(R_SUCCEEDED(rc))
 	{
 		file->pos += adv;
 		return adv;
@@ -664,6 +1107,16 @@ int romfs_stat(struct _reent *r, const char *path, struct stat *st)
 {
 	romfs_mount* mount = (romfs_mount*)r->deviceData;
 	romfs_dir* curDir = NULL;
+	romfs_file* curFile = NULL;
+	if (_romfs_index_lookup(mount, path, &curDir, &curFile))
+	{
+		if (curDir)
+			fill_dir(st, mount, curDir);
+		else
+			fill_file(st, mount, curFile);
+		return 0;
+	}
+
 	r->_errno = navigateToDir(mount, &curDir, &path, false);
 	if(r->_errno != 0)
 		return -1;
@@ -708,9 +1161,12 @@ int romfs_chdir(struct _reent *r, const char *path)
 {
 	romfs_mount* mount = (romfs_mount*)r->deviceData;
 	romfs_dir* curDir = NULL;
-	r->_errno = navigateToDir(mount, &curDir, &path, true);
-	if (r->_errno != 0)
-		return -1;
+	if (!_romfs_index_lookup(mount, path, &curDir, NULL))
+	{
+		r->_errno = navigateToDir(mount, &curDir, &path, true);
+		if (r->_errno != 0)
+			return -1;
+	}
 
 	mount->cwd = curDir;
 	return 0;
@@ -722,9 +1178,12 @@ DIR_ITER* romfs_diropen(struct _reent *r, DIR_ITER *dirState, const char *path)
 	romfs_dir* curDir = NULL;
 	iter->mount = (romfs_mount*)r->deviceData;
 
-	r->_errno = navigateToDir(iter->mount, &curDir, &path, true);
-	if(r->_errno != 0)
-		return NULL;
+	if (!_romfs_index_lookup(iter->mount, path, &curDir, NULL))
+	{
+		r->_errno = navigateToDir(iter->mount, &curDir, &path, true);
+		if(r->_errno != 0)
+			return NULL;
+	}
 
 	iter->dir       = curDir;
 	iter->state     = 0;
@@ -2,6 +2,7 @@
 #include <3ds/types.h>
 #include <3ds/svc.h>
 #include <3ds/result.h>
+#include <3ds/os.h>
 #include <3ds/synchronization.h>
 
 static Handle arbiter;
@@ -27,6 +28,18 @@ Result syncArbitrateAddressWithTimeout(s32* addr, ArbitrationType type, s32 valu
 	return svcArbitrateAddress(arbiter, (u32)addr, type, value, timeout_ns);
 }
 
+static inline bool syncIsTimeout(Result res)
+{
+	return R_DESCRIPTION(res) == RD_TIMEOUT;
+}
+
+// Time left of a timeout that started at the given tick, so that retries do not restart it
+static inline s64 syncTimeoutLeft(u64 start, s64 timeout_ns)
+{
+	s64 elapsed = (s64)((svcGetSystemTick() - start) * (1000.0 / CPU_TICKS_PER_USEC));
+	return elapsed < timeout_ns ? timeout_ns - elapsed : 0;
+}
+
 void LightLock_Init(LightLock* lock)
 {
 	do
@@ -34,8 +47,129 @@ void LightLock_Init(LightLock* lock)
 	while (__strex(lock, 1));
 }
 
+static u32 s_spinMax; // maximum number of spins, 0 to never spin
+static u32 s_spinAvg; // recent number of spins needed to get a lock; updated without synchronization since it is only a hint
+
+#ifdef LIGHTLOCK_PROFILE
+#define LIGHTLOCK_STATS_COUNT 256
+
+static LightLockStats s_lockStats[LIGHTLOCK_STATS_COUNT];
+
+static LightLockStats* LightLock_GetStats(LightLock* lock)
+{
+	u32 i = (((u32)lock >> 2) * 0x9E3779B1U) >> 24;
+	for (u32 n = 0; n < LIGHTLOCK_STATS_COUNT; n ++, i = (i + 1) % LIGHTLOCK_STATS_COUNT)
+	{
+		LightLockStats* stats = &s_lockStats[i];
+		LightLock* cur;
+
+		// Claim the first free entry along the probe sequence
+		do
+		{
+			cur = (LightLock*)__ldrex((s32*)&stats->lock);
+			if (cur != NULL)
+			{
+				__clrex();
+				break;
+			}
+		} while (__strex((s32*)&stats->lock, (s32)lock));
+
+		if (cur == NULL || cur == lock)
+			return stats;
+	}
+
+	return NULL; // table full, the lock goes unrecorded
+}
+
+static inline u64 LightLock_Ticks(void)
+{
+	return svcGetSystemTick();
+}
+
+static void LightLock_Record(LightLock* lock, bool contended, u64 start)
+{
+	LightLockStats* stats = LightLock_GetStats(lock);
+	if (!stats)
+		return;
+
+	AtomicIncrement(&stats->acquisitions);
+	if (contended)
+	{
+		AtomicIncrement(&stats->contended);
+		__atomic_fetch_add(&stats->wait_ticks, svcGetSystemTick() - start, __ATOMIC_RELAXED);
+	}
+}
+#else
+static inline u64 LightLock_Ticks(void)
+{
+	return 0;
+}
+
+static inline void LightLock_Record(LightLock* lock, bool contended, u64 start)
+{
+}
+#endif
+
+static inline int LightLock_TryLockImpl(LightLock* lock)
+{
+	s32 val;
+	do
+	{
+		val = __ldrex(lock);
+		if (val == 0) val = 1; // 0 is an invalid state - treat it as 1 (unlocked)
+		if (val < 0)
+		{
+			__clrex();
+			return 1; // Failure
+		}
+	} while (__strex(lock, -val));
+
+	__dmb();
+	return 0; // Success
+}
+
+static bool LightLock_Spin(LightLock* lock)
+{
+	// Spin a bit longer than it recently took to get a lock, so that spinning stops paying for locks held too long
+	u32 limit = 2*s_spinAvg + 16;
+	if (limit > s_spinMax)
+		limit = s_spinMax;
+
+	u32 i;
+	for (i = 0; i < limit; i ++)
+	{
+		s32 val = *(volatile s32*)lock;
+		if (val < -1)
+			break; // other threads are already asleep waiting for the lock, so it is held for long
+
+		if (val >= 0 && LightLock_TryLockImpl(lock) == 0)
+		{
+			s_spinAvg += ((s32)i - (s32)s_spinAvg) / 8;
+			return true;
+		}
+
+		__asm__ __volatile__("yield");
+	}
+
+	s_spinAvg += ((s32)limit - (s32)s_spinAvg) / 8;
+	return false;
+}
+
 void LightLock_Lock(LightLock* lock)
 {
+	if (LightLock_TryLockImpl(lock) == 0)
+	{
+		LightLock_Record(lock, false, 0);
+		return;
+	}
+
+	u64 start = LightLock_Ticks();
+	if (s_spinMax && LightLock_Spin(lock))
+	{
+		LightLock_Record(lock, true, start);
+		return;
+	}
+
 	s32 val;
 	bool bAlreadyLocked;
 
@@ -80,23 +214,15 @@ void LightLock_Lock(LightLock* lock)
 	}
 
 	__dmb();
+	LightLock_Record(lock, true, start);
 }
 
 int LightLock_TryLock(LightLock* lock)
 {
-	s32 val;
-	do
-	{
-		val = __ldrex(lock);
-		if (val == 0) val = 1; // 0 is an invalid state - treat it as 1 (unlocked)
-		if (val < 0)
-		{
-			__clrex();
-			return 1; // Failure
-		}
-	} while (__strex(lock, -val));
+	if (LightLock_TryLockImpl(lock))
+		return 1; // Failure
 
-	__dmb();
+	LightLock_Record(lock, false, 0);
 	return 0; // Success
 }
 
@@ -114,6 +240,40 @@ void LightLock_Unlock(LightLock* lock)
 		syncArbitrateAddress(lock, ARBITRATION_SIGNAL, 1);
 }
 
+void LightLock_SetSpinCount(u32 count)
+{
+	s_spinMax = count;
+}
+
+u32 LightLock_GetTopContended(LightLockStats* stats, u32 max_stats)
+{
+	u32 count = 0;
+#ifdef LIGHTLOCK_PROFILE
+	for (u32 i = 0; i < LIGHTLOCK_STATS_COUNT; i ++)
+	{
+		LightLockStats cur = s_lockStats[i];
+		if (!cur.lock || !cur.contended)
+			continue;
+
+		// Insertion sort by time spent waiting, keeping only the top entries
+		u32 j = count < max_stats ? count ++ : max_stats;
+		for (; j > 0 && stats[j-1].wait_ticks < cur.wait_ticks; j --)
+			if (j < max_stats)
+				stats[j] = stats[j-1];
+		if (j < max_stats)
+			stats[j] = cur;
+	}
+#endif
+	return count;
+}
+
+void LightLock_ResetStats(void)
+{
+#ifdef LIGHTLOCK_PROFILE
+	memset(s_lockStats, 0, sizeof(s_lockStats));
+#endif
+}
+
 void RecursiveLock_Init(RecursiveLock* lock)
 {
 	LightLock_Init(&lock->lock);
@@ -203,7 +363,7 @@ int CondVar_WaitTimeout(CondVar* cv, LightLock* lock, s64 timeout_ns)
 
 	bool timedOut = false;
 	Result rc = syncArbitrateAddressWithTimeout(cv, ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT, 0, timeout_ns);
-	if (R_DESCRIPTION(rc) == RD_TIMEOUT)
+	if (syncIsTimeout(rc))
 	{
 		timedOut = CondVar_EndWait(cv, 1);
 		__dmb();
@@ -238,6 +398,22 @@ static inline void LightEvent_SetState(LightEvent* event, int state)
 	while (__strex(&event->state, state));
 }
 
+// 0 while a thread is in LightEvent_WaitAny, which every signal then wakes up
+static s32 s_waitAnyState = 1;
+
+static inline void LightEvent_WakeWaitAny(void)
+{
+	// Pairs with the barrier in LightEvent_WaitAnyImpl: either the waiter sees the event or we see the waiter
+	__dmb();
+	if (s_waitAnyState == 0)
+	{
+		do
+			__ldrex(&s_waitAnyState);
+		while (__strex(&s_waitAnyState, 1));
+		syncArbitrateAddress(&s_waitAnyState, ARBITRATION_SIGNAL, ARBITRATION_SIGNAL_ALL);
+	}
+}
+
 static inline int LightEvent_TryReset(LightEvent* event)
 {
 	__dmb();
@@ -291,12 +467,14 @@ void LightEvent_Signal(LightEvent* event)
 		__dmb();
 		LightEvent_SetState(event, SIGNALED_ONESHOT);
 		syncArbitrateAddress(&event->state, ARBITRATION_SIGNAL, 1);
+		LightEvent_WakeWaitAny();
 	} else if (event->state == CLEARED_STICKY)
 	{
 		LightLock_Lock(&event->lock);
 		LightEvent_SetState(event, SIGNALED_STICKY);
 		syncArbitrateAddress(&event->state, ARBITRATION_SIGNAL, -1);
 		LightLock_Unlock(&event->lock);
+		LightEvent_WakeWaitAny();
 	}
 }
 
@@ -329,15 +507,14 @@ void LightEvent_Wait(LightEvent* event)
 
 int LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns)
 {
-	Result  timeoutRes = 0x09401BFE;
 	Result  res = 0;
 
-	while (res != timeoutRes)
+	while (!syncIsTimeout(res))
 	{
 		if (event->state == CLEARED_STICKY)
 		{
 			res = syncArbitrateAddressWithTimeout(&event->state, ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT, SIGNALED_ONESHOT, timeout_ns);
-			return res == timeoutRes;
+			return syncIsTimeout(res);
 		}
 
 		if (event->state != CLEARED_ONESHOT)
@@ -352,7 +529,51 @@ int LightEvent_WaitTimeout(LightEvent* event, s64 timeout_ns)
 		res = syncArbitrateAddressWithTimeout(&event->state, ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT, SIGNALED_ONESHOT, timeout_ns);
 	}
 
-	return res == timeoutRes;
+	return syncIsTimeout(res);
+}
+
+static s32 LightEvent_WaitAnyImpl(LightEvent* const* events, s32 count, s64 timeout_ns)
+{
+	Result res = 0;
+	u64 start = svcGetSystemTick();
+
+	for (;;)
+	{
+		for (s32 i = 0; i < count; i ++)
+			if (LightEvent_TryWait(events[i]))
+				return i;
+
+		if (syncIsTimeout(res))
+			return -1;
+
+		// Announce the wait, then look again before sleeping so that no signal goes unnoticed
+		do
+			__ldrex(&s_waitAnyState);
+		while (__strex(&s_waitAnyState, 0));
+		__dmb();
+
+		for (s32 i = 0; i < count; i ++)
+			if (LightEvent_TryWait(events[i]))
+				return i;
+
+		if (timeout_ns < 0)
+			syncArbitrateAddress(&s_waitAnyState, ARBITRATION_WAIT_IF_LESS_THAN, 1);
+		else
+		{
+			// Other events wake us up too, so only wait for what is left of the timeout
+			res = syncArbitrateAddressWithTimeout(&s_waitAnyState, ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT, 1, syncTimeoutLeft(start, timeout_ns));
+		}
+	}
+}
+
+s32 LightEvent_WaitAny(LightEvent* const* events, s32 count)
+{
+	return LightEvent_WaitAnyImpl(events, count, -1);
+}
+
+s32 LightEvent_WaitAnyTimeout(LightEvent* const* events, s32 count, s64 timeout_ns)
+{
+	return LightEvent_WaitAnyImpl(events, count, timeout_ns < 0 ? 0 : timeout_ns);
 }
 
 void LightSemaphore_Init(LightSemaphore* semaphore, s16 initial_count, s16 max_count)
@@ -424,3 +645,354 @@ void LightSemaphore_Release(LightSemaphore* semaphore, s32 count)
 	if(old_count <= 0 || semaphore->num_threads_acq > 0)
 		syncArbitrateAddress(&semaphore->current_count, ARBITRATION_SIGNAL, count);
 }
+
+void LightBarrier_Init(LightBarrier* barrier, s32 count)
+{
+	barrier->remaining = count;
+	barrier->count = count;
+	barrier->sense = 0;
+	barrier->released[0] = 0;
+	barrier->released[1] = 0;
+	__dmb();
+}
+
+int LightBarrier_Wait(LightBarrier* barrier)
+{
+	// The phase only changes once every thread has arrived, including this one
+	s32 sense = barrier->sense;
+	__dmb();
+
+	s32 remaining;
+	do
+		remaining = __ldrex(&barrier->remaining) - 1;
+	while (__strex(&barrier->remaining, remaining));
+
+	if (remaining == 0)
+	{
+		// Every thread has left the previous phase by now, so its flag can be reused for the next one
+		barrier->remaining = barrier->count;
+		barrier->released[sense ^ 1] = 0;
+		barrier->sense = sense ^ 1;
+		__dmb();
+
+		barrier->released[sense] = 1;
+		syncArbitrateAddress(&barrier->released[sense], ARBITRATION_SIGNAL, ARBITRATION_SIGNAL_ALL);
+		return 1;
+	}
+
+	while (*(volatile s32*)&barrier->released[sense] < 1)
+		syncArbitrateAddress(&barrier->released[sense], ARBITRATION_WAIT_IF_LESS_THAN, 1);
+
+	__dmb();
+	return 0;
+}
+
+// LightOnce state
+enum
+{
+	ONCE_NOT_RUN = LIGHTONCE_INIT,
+	ONCE_RUNNING = 1,
+	ONCE_RUNNING_WAITERS = 2,
+	ONCE_DONE = 3,
+};
+
+void LightOnce_Call(LightOnce* once, void (*func)(void* arg), void* arg)
+{
+	if (*(volatile s32*)once == ONCE_DONE)
+	{
+		__dmb();
+		return;
+	}
+
+	s32 val;
+	do
+	{
+		val = __ldrex(once);
+		if (val == ONCE_DONE)
+		{
+			__clrex();
+			__dmb();
+			return;
+		}
+	} while (__strex(once, val == ONCE_NOT_RUN ? ONCE_RUNNING : ONCE_RUNNING_WAITERS));
+
+	if (val == ONCE_NOT_RUN)
+	{
+		func(arg);
+		__dmb();
+
+		do
+			val = __ldrex(once);
+		while (__strex(once, ONCE_DONE));
+
+		if (val == ONCE_RUNNING_WAITERS)
+			syncArbitrateAddress(once, ARBITRATION_SIGNAL, ARBITRATION_SIGNAL_ALL);
+		return;
+	}
+
+	while (*(volatile s32*)once != ONCE_DONE)
+		syncArbitrateAddress(once, ARBITRATION_WAIT_IF_LESS_THAN, ONCE_DONE);
+	__dmb();
+}
+
+// LightRWLock state
+enum
+{
+	RWLOCK_READERS_MASK    = 0x3FF,
+	RWLOCK_READER_WAITER   = 1 << 10,
+	RWLOCK_READER_WAITERS  = 0x7FC00,
+	RWLOCK_WRITER_WAITER   = 1 << 19,
+	RWLOCK_WRITER_WAITERS  = 0xFF80000,
+	RWLOCK_WRITER_WOKEN    = 1 << 28,
+	RWLOCK_WRITE_LOCKED    = 1 << 30,
+	RWLOCK_READERS_BLOCKED = (s32)(1U << 31), // keeps the state negative, so readers can sleep on it
+};
+
+static inline s32 LightRWLock_Settle(LightRWLock* lock, s32 val, bool* wakeReaders, bool* wakeWriter)
+{
+	// Readers are blocked by the writer, and also by waiting writers if those go first
+	bool blocked = (val & RWLOCK_WRITE_LOCKED) || (lock->policy == RWLOCK_PREFER_WRITERS && (val & RWLOCK_WRITER_WAITERS));
+	val = blocked ? (val | RWLOCK_READERS_BLOCKED) : (val & ~RWLOCK_READERS_BLOCKED);
+
+	// Waiting readers stay counted until they get to retry, so a wake-up sent before one of them sleeps is repeated
+	*wakeReaders = !blocked && (val & RWLOCK_READER_WAITERS);
+
+	// Hand the free lock to one waiting writer, unless one is already on its way
+	*wakeWriter = (val & RWLOCK_WRITER_WAITERS) && !(val & (RWLOCK_WRITE_LOCKED | RWLOCK_WRITER_WOKEN | RWLOCK_READERS_MASK));
+	if (*wakeWriter)
+		val |= RWLOCK_WRITER_WOKEN;
+
+	return val;
+}
+
+static inline void LightRWLock_Wake(LightRWLock* lock, bool wakeReaders, bool wakeWriter)
+{
+	if (wakeWriter)
+	{
+		s32 val;
+		do
+			val = __ldrex(&lock->writer_tokens) + 1;
+		while (__strex(&lock->writer_tokens, val));
+		syncArbitrateAddress(&lock->writer_tokens, ARBITRATION_SIGNAL, 1);
+	}
+
+	if (wakeReaders)
+		syncArbitrateAddress(&lock->state, ARBITRATION_SIGNAL, ARBITRATION_SIGNAL_ALL);
+}
+
+static inline bool LightRWLock_TakeToken(LightRWLock* lock)
+{
+	s32 val;
+	do
+	{
+		val = __ldrex(&lock->writer_tokens);
+		if (val <= 0)
+		{
+			__clrex();
+			return false;
+		}
+	} while (__strex(&lock->writer_tokens, val - 1));
+	return true;
+}
+
+static int LightRWLock_ReadLockImpl(LightRWLock* lock, s64 timeout_ns)
+{
+	bool registered = false, timedOut = false;
+	u64 start = timeout_ns < 0 ? 0 : svcGetSystemTick();
+	for (;;)
+	{
+		s32 val;
+		bool acquired;
+		do
+		{
+			val = __ldrex(&lock->state);
+			acquired = val >= 0;
+			if (acquired)
+				val += 1 - (registered ? RWLOCK_READER_WAITER : 0); // add a reader
+			else if (timedOut)
+				val -= RWLOCK_READER_WAITER; // give up
+			else if (!registered)
+				val += RWLOCK_READER_WAITER;
+		} while (__strex(&lock->state, val));
+
+		if (acquired)
+			break;
+		if (timedOut)
+			return 1; // Failure
+
+		registered = true;
+
+		// Sleep while readers are blocked
+		if (timeout_ns < 0)
+			syncArbitrateAddress(&lock->state, ARBITRATION_WAIT_IF_LESS_THAN, 0);
+		else
+		{
+			// Wake-ups which do not end up acquiring must not restart the timeout
+			Result rc = syncArbitrateAddressWithTimeout(&lock->state, ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT, 0, syncTimeoutLeft(start, timeout_ns));
+			timedOut = syncIsTimeout(rc); // try once more before giving up
+		}
+	}
+
+	__dmb();
+	return 0; // Success
+}
+
+static int LightRWLock_WriteLockImpl(LightRWLock* lock, s64 timeout_ns)
+{
+	bool registered = false, woken = false, timedOut = false;
+	bool wakeReaders, wakeWriter;
+	u64 start = timeout_ns < 0 ? 0 : svcGetSystemTick();
+	for (;;)
+	{
+		s32 val;
+		bool acquired;
+		do
+		{
+			val = __ldrex(&lock->state);
+
+			// A woken writer clears the flag whether or not it gets the lock, so the next unlock wakes a writer again
+			if (woken)
+				val &= ~RWLOCK_WRITER_WOKEN;
+
+			acquired = !(val & (RWLOCK_WRITE_LOCKED | RWLOCK_READERS_MASK));
+			if (acquired)
+			{
+				val |= RWLOCK_WRITE_LOCKED;
+				if (registered)
+					val -= RWLOCK_WRITER_WAITER;
+			}
+			else if (timedOut)
+				val -= RWLOCK_WRITER_WAITER; // give up
+			else if (!registered)
+				val += RWLOCK_WRITER_WAITER;
+
+			val = LightRWLock_Settle(lock, val, &wakeReaders, &wakeWriter);
+		} while (__strex(&lock->state, val));
+
+		LightRWLock_Wake(lock, wakeReaders, wakeWriter);
+
+		if (acquired)
+			break;
+		if (timedOut)
+			return 1; // Failure
+
+		registered = true;
+		woken = false;
+
+		// Wait for an unlock to hand us a wake-up
+		while (!woken)
+		{
+			woken = LightRWLock_TakeToken(lock);
+			if (woken)
+				break;
+
+			if (timeout_ns < 0)
+				syncArbitrateAddress(&lock->writer_tokens, ARBITRATION_WAIT_IF_LESS_THAN, 1);
+			else
+			{
+				Result rc = syncArbitrateAddressWithTimeout(&lock->writer_tokens, ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT, 1, syncTimeoutLeft(start, timeout_ns));
+				if (syncIsTimeout(rc))
+				{
+					// A wake-up may have been handed to us just as we timed out, which we must not drop
+					woken = LightRWLock_TakeToken(lock);
+					timedOut = true;
+					break;
+				}
+			}
+		}
+	}
+
+	__dmb();
+	return 0; // Success
+}
+
+void LightRWLock_Init(LightRWLock* lock, RWLockPolicy policy)
+{
+	lock->policy = policy;
+	lock->writer_tokens = 0;
+	do
+		__ldrex(&lock->state);
+	while (__strex(&lock->state, 0));
+}
+
+void LightRWLock_ReadLock(LightRWLock* lock)
+{
+	LightRWLock_ReadLockImpl(lock, -1);
+}
+
+int LightRWLock_TryReadLock(LightRWLock* lock)
+{
+	s32 val;
+	do
+	{
+		val = __ldrex(&lock->state);
+		if (val < 0)
+		{
+			__clrex();
+			return 1; // Failure
+		}
+	} while (__strex(&lock->state, val + 1));
+
+	__dmb();
+	return 0; // Success
+}
+
+int LightRWLock_ReadLockTimeout(LightRWLock* lock, s64 timeout_ns)
+{
+	return LightRWLock_ReadLockImpl(lock, timeout_ns < 0 ? 0 : timeout_ns);
+}
+
+void LightRWLock_ReadUnlock(LightRWLock* lock)
+{
+	__dmb();
+
+	s32 val;
+	bool wakeReaders, wakeWriter;
+	do
+		val = LightRWLock_Settle(lock, __ldrex(&lock->state) - 1, &wakeReaders, &wakeWriter);
+	while (__strex(&lock->state, val));
+
+	LightRWLock_Wake(lock, wakeReaders, wakeWriter);
+}
+
+void LightRWLock_WriteLock(LightRWLock* lock)
+{
+	LightRWLock_WriteLockImpl(lock, -1);
+}
+
+int LightRWLock_TryWriteLock(LightRWLock* lock)
+{
+	s32 val;
+	bool wakeReaders, wakeWriter;
+	do
+	{
+		val = __ldrex(&lock->state);
+		if (val & (RWLOCK_WRITE_LOCKED | RWLOCK_READERS_MASK))
+		{
+			__clrex();
+			return 1; // Failure
+		}
+		val = LightRWLock_Settle(lock, val | RWLOCK_WRITE_LOCKED, &wakeReaders, &wakeWriter);
+	} while (__strex(&lock->state, val));
+
+	__dmb();
+	return 0; // Success
+}
+
+int LightRWLock_WriteLockTimeout(LightRWLock* lock, s64 timeout_ns)
+{
+	return LightRWLock_WriteLockImpl(lock, timeout_ns < 0 ? 0 : timeout_ns);
+}
+
+void LightRWLock_WriteUnlock(LightRWLock* lock)
+{
+	__dmb();
+
+	s32 val;
+	bool wakeReaders, wakeWriter;
+	do
+		val = LightRWLock_Settle(lock, __ldrex(&lock->state) & ~RWLOCK_WRITE_LOCKED, &wakeReaders, &wakeWriter);
+	while (__strex(&lock->state, val));
+
+	LightRWLock_Wake(lock, wakeReaders, wakeWriter);
+}
@@ -1,7 +1,9 @@
 #include "internal.h"
+#include <3ds/allocator/linear.h>
 #include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
+#include <errno.h>
 
 static void __panic(void)
 {
@@ -9,6 +11,27 @@ static void __panic(void)
 	for (;;);
 }
 
+typedef struct ThreadPoolWorker
+{
+	struct ThreadPoolWorker* next;
+	ThreadPool pool;
+	Thread thread;
+	ThreadFunc ep;
+	void* arg;
+	s32 wake;
+} ThreadPoolWorker;
+
+struct ThreadPool_tag
+{
+	LightLock lock;
+	CondVar idleCond;
+	CondVar doneCond;
+	ThreadPoolWorker* idle;
+	u32 busy;
+	u32 count;
+	ThreadPoolWorker workers[];
+};
+
 static void _thread_begin(void* arg)
 {
 	Thread t = (Thread)arg;
@@ -126,6 +149,9 @@ void threadExit(int rc)
 	if (!t)
 		__panic();
 
+	// Return any buffers cached by this thread to the linear heap
+	linearCacheFlush();
+
 	t->finished = true;
 	if (t->detached)
 		threadFree(t);
@@ -134,3 +160,136 @@ void threadExit(int rc)
 
 	svcExitThread();
 }
+
+static void _thread_pool_main(void* arg)
+{
+	ThreadPoolWorker* w = (ThreadPoolWorker*)arg;
+	ThreadPool pool = w->pool;
+
+	for (;;)
+	{
+		// Stay parked until a function is handed over
+		while (!__atomic_load_n(&w->wake, __ATOMIC_ACQUIRE))
+			syncArbitrateAddress(&w->wake, ARBITRATION_WAIT_IF_LESS_THAN, 1);
+		w->wake = 0;
+
+		if (!w->ep)
+			break;
+
+		errno = 0;
+		w->ep(w->arg);
+
+		LightLock_Lock(&pool->lock);
+		w->next = pool->idle;
+		pool->idle = w;
+		if (--pool->busy == 0)
+			CondVar_Broadcast(&pool->doneCond);
+		CondVar_Signal(&pool->idleCond);
+		LightLock_Unlock(&pool->lock);
+	}
+}
+
+static void _thread_pool_dispatch(ThreadPoolWorker* w, ThreadFunc entrypoint, void* arg)
+{
+	w->ep  = entrypoint;
+	w->arg = arg;
+	__atomic_store_n(&w->wake, 1, __ATOMIC_RELEASE);
+	syncArbitrateAddress(&w->wake, ARBITRATION_SIGNAL, 1);
+}
+
+// Must be called with pool->lock held and an idle worker available
+static ThreadPoolWorker* _thread_pool_take(ThreadPool pool)
+{
+	ThreadPoolWorker* w = pool->idle;
+	pool->idle = w->next;
+	pool->busy++;
+	return w;
+}
+
+ThreadPool threadPoolCreate(u32 num_threads, size_t stack_size, int prio, int core_id)
+{
+	if (!num_threads || num_threads > (SIZE_MAX - sizeof(struct ThreadPool_tag)) / sizeof(ThreadPoolWorker))
+		return NULL;
+
+	ThreadPool pool = (ThreadPool)malloc(sizeof(struct ThreadPool_tag) + num_threads * sizeof(ThreadPoolWorker));
+	if (!pool) return NULL;
+
+	LightLock_Init(&pool->lock);
+	CondVar_Init(&pool->idleCond);
+	CondVar_Init(&pool->doneCond);
+	pool->idle  = NULL;
+	pool->busy  = 0;
+	pool->count = 0;
+
+	while (pool->count < num_threads)
+	{
+		ThreadPoolWorker* w = &pool->workers[pool->count];
+		w->pool = pool;
+		w->ep   = NULL;
+		w->wake = 0;
+		w->thread = threadCreate(_thread_pool_main, w, stack_size, prio, core_id, false);
+		if (!w->thread)
+		{
+			threadPoolFree(pool);
+			return NULL;
+		}
+
+		w->next = pool->idle;
+		pool->idle = w;
+		pool->count++;
+	}
+
+	return pool;
+}
+
+void threadPoolRun(ThreadPool pool, ThreadFunc entrypoint, void* arg)
+{
+	LightLock_Lock(&pool->lock);
+	while (!pool->idle)
+		CondVar_Wait(&pool->idleCond, &pool->lock);
+	ThreadPoolWorker* w = _thread_pool_take(pool);
+	LightLock_Unlock(&pool->lock);
+
+	_thread_pool_dispatch(w, entrypoint, arg);
+}
+
+bool threadPoolTryRun(ThreadPool pool, ThreadFunc entrypoint, void* arg)
+{
+	LightLock_Lock(&pool->lock);
+	if (!pool->idle)
+	{
+		LightLock_Unlock(&pool->lock);
+		return false;
+	}
+	ThreadPoolWorker* w = _thread_pool_take(pool);
+	LightLock_Unlock(&pool->lock);
+
+	_thread_pool_dispatch(w, entrypoint, arg);
+	return true;
+}
+
+void threadPoolWait(ThreadPool pool)
+{
+	LightLock_Lock(&pool->lock);
+	while (pool->busy)
+		CondVar_Wait(&pool->doneCond, &pool->lock);
+	LightLock_Unlock(&pool->lock);
+}
+
+void threadPoolFree(ThreadPool pool)
+{
+	if (!pool) return;
+
+	threadPoolWait(pool);
+
+	// A NULL function makes the thread return from its entrypoint
+	for (u32 i = 0; i < pool->count; i ++)
+	{
+		ThreadPoolWorker* w = &pool->workers[i];
+		_thread_pool_dispatch(w, NULL, NULL);
+		threadJoin(w->thread, U64_MAX);
+		threadFree(w->thread);
+	}
+
+	free(pool);
+}
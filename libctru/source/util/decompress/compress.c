@@ -0,0 +1,779 @@
+/** @file compress.c
+ *  @brief Compression routines
+ */
+#include <3ds/util/compress.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZ_WINDOW    0x1000  ///< Back-reference window size
+#define LZ_HASH_BITS 12      ///< Match finder hash size
+#define LZ_NONE      UINT32_MAX
+#define LZ_MIN       3       ///< Minimum match length
+#define LZSS_MAX     0x12    ///< LZSS maximum match length
+#define LZ11_MAX     0x10110 ///< LZ11 maximum match length
+#define HUFF_SYMBOLS 256     ///< Maximum number of Huffman symbols
+
+/** @brief Hash chain match finder */
+typedef struct
+{
+  uint32_t head[1 << LZ_HASH_BITS]; ///< Most recent position per hash
+  uint32_t prev[LZ_WINDOW];         ///< Previous position with the same hash
+} lz_matcher;
+
+/** @brief Match finder settings for a compression level */
+typedef struct
+{
+  uint16_t chain; ///< Maximum number of candidates to check
+  uint32_t nice;  ///< Match length which ends the search early
+  bool     lazy;  ///< Whether to check for a longer match at the next byte
+} lz_level;
+
+/** @brief Match finder settings for each compression level */
+static const lz_level lz_levels[COMPRESS_LEVEL_MAX] =
+{
+  {    2,        8, false },
+  {    4,       16, false },
+  {    8,       32, false },
+  {   16,       32, true  },
+  {   32,       64, true  },
+  {   64,      128, true  },
+  {  128,      256, true  },
+  {  512,     1024, true  },
+  { 4096, LZ11_MAX, true  },
+};
+
+/** @brief Huffman tree node */
+typedef struct
+{
+  uint32_t freq;     ///< Frequency
+  uint16_t child[2]; ///< Children, if not a leaf
+  uint16_t parent;   ///< Parent, if not the root
+  uint16_t symbol;   ///< Symbol, if a leaf
+  bool     leaf;     ///< Whether this is a leaf
+  uint16_t index;    ///< Position in the encoded tree
+} huff_node;
+
+/** @brief Huffman encoder working memory */
+typedef struct
+{
+  huff_node nodes[2 * HUFF_SYMBOLS - 1]; ///< Tree nodes
+  uint32_t  code[HUFF_SYMBOLS][8];       ///< Symbol codes
+  uint8_t   length[HUFF_SYMBOLS];        ///< Symbol code lengths
+} huff_encoder;
+
+/** @brief Write a little-endian 32-bit value
+ *  @param[out] data  Output buffer
+ *  @param[in]  value Value
+ */
+static inline void
+write_u32(uint8_t *data, uint32_t value)
+{
+  data[0] = value >>  0;
+  data[1] = value >>  8;
+  data[2] = value >> 16;
+  data[3] = value >> 24;
+}
+
+/** @brief Write a compression header
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  type    Compression type
+ *  @param[in]  size    Decompressed size
+ *  @returns Header size
+ *  @retval 0 output buffer too small
+ */
+static size_t
+compress_header(uint8_t *output, size_t outsize, decompressType type,
+                size_t size)
+{
+  size_t bytes = size > 0xFFFFFF ? 8 : 4;
+  if(outsize < bytes)
+    return 0;
+
+  output[0] = type;
+  output[1] = size >>  0;
+  output[2] = size >>  8;
+  output[3] = size >> 16;
+
+  if(bytes == 8)
+  {
+    // extended header for large data
+    output[0] |= 0x80;
+    write_u32(&output[4], size >> 24);
+  }
+
+  return bytes;
+}
+
+/** @brief Hash the bytes at a position
+ *  @param[in] data Data
+ *  @returns Hash
+ */
+static inline uint32_t
+lz_hash(const uint8_t *data)
+{
+  uint32_t value = data[0] << 16 | data[1] << 8 | data[2];
+  return (value * 0x9E3779B1U) >> (32 - LZ_HASH_BITS);
+}
+
+/** @brief Add a position to the match finder
+ *  @param[in] matcher Match finder
+ *  @param[in] input   Input data
+ *  @param[in] pos     Position to add
+ */
+static inline void
+lz_insert(lz_matcher *matcher, const uint8_t *input, size_t pos)
+{
+  uint32_t hash = lz_hash(&input[pos]);
+  matcher->prev[pos & (LZ_WINDOW - 1)] = matcher->head[hash];
+  matcher->head[hash] = pos;
+}
+
+/** @brief Find the longest match for a position
+ *  @param[in]  matcher Match finder
+ *  @param[in]  input   Input data
+ *  @param[in]  pos     Position to match
+ *  @param[in]  maxLen  Maximum match length
+ *  @param[in]  level   Match finder settings
+ *  @param[out] dist    Match distance
+ *  @returns Match length
+ */
+static size_t
+lz_find(const lz_matcher *matcher, const uint8_t *input, size_t pos,
+        size_t maxLen, const lz_level *level, size_t *dist)
+{
+  size_t   chain = level->chain;
+  size_t   best = 0;
+  uint32_t cand = matcher->head[lz_hash(&input[pos])];
+
+  while(cand != LZ_NONE && chain-- > 0 && pos - cand <= LZ_WINDOW)
+  {
+    // check the byte which would make this the best match first
+    if(input[cand + best] == input[pos + best])
+    {
+      size_t len = 0;
+      while(len < maxLen && input[cand + len] == input[pos + len])
+        ++len;
+
+      if(len > best)
+      {
+        best  = len;
+        *dist = pos - cand;
+        if(len == maxLen || len >= level->nice)
+          break;
+      }
+    }
+
+    uint32_t next = matcher->prev[cand & (LZ_WINDOW - 1)];
+    if(next == LZ_NONE || next >= cand)
+      break;
+    cand = next;
+  }
+
+  return best;
+}
+
+/** @brief Compress LZSS/LZ10 or LZ11
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress
+ *  @param[in]  insize  Data size
+ *  @param[in]  type    Compression type
+ *  @param[in]  level   Compression level
+ *  @returns Compressed size
+ *  @retval -1 error
+ */
+static ssize_t
+compress_lz(uint8_t *output, size_t outsize, const uint8_t *input,
+            size_t insize, decompressType type, int level)
+{
+  size_t out = compress_header(output, outsize, type, insize);
+  if(out == 0)
+    return -1;
+
+  lz_matcher *matcher = (lz_matcher*)malloc(sizeof(*matcher));
+  if(!matcher)
+    return -1;
+
+  memset(matcher->head, 0xFF, sizeof(matcher->head));
+
+  if(level <= 0)
+    level = COMPRESS_LEVEL_DEFAULT;
+  else if(level > COMPRESS_LEVEL_MAX)
+    level = COMPRESS_LEVEL_MAX;
+
+  const lz_level *settings = &lz_levels[level - 1];
+  size_t  limit = type == DECOMPRESS_LZ11 ? LZ11_MAX : LZSS_MAX;
+  size_t  pos   = 0;
+  size_t  added = 0; // positions added to the match finder
+  size_t  flags = 0;
+  uint8_t mask  = 0;
+
+  while(pos < insize)
+  {
+    // a flags byte plus the longest block
+    if(outsize - out < 5)
+    {
+      free(matcher);
+      return -1;
+    }
+
+    if(mask == 0)
+    {
+      flags = out++;
+      output[flags] = 0;
+      mask = 0x80;
+    }
+
+    size_t maxLen = insize - pos < limit ? insize - pos : limit;
+    size_t len = 0, dist = 0;
+    if(maxLen >= LZ_MIN)
+      len = lz_find(matcher, input, pos, maxLen, settings, &dist);
+
+    if(settings->lazy && len >= LZ_MIN && len < settings->nice
+    && maxLen > len)
+    {
+      // a longer match at the next byte is worth a literal
+      for(; added <= pos; ++added)
+        lz_insert(matcher, input, added);
+
+      size_t nextLen = insize - pos - 1 < limit ? insize - pos - 1 : limit;
+      size_t nextDist = 0;
+      if(lz_find(matcher, input, pos + 1, nextLen, settings, &nextDist) > len)
+        len = 0;
+    }
+
+    if(len >= LZ_MIN)
+    {
+      size_t disp = dist - 1;
+      output[flags] |= mask;
+
+      if(type == DECOMPRESS_LZSS)
+      {
+        output[out++] = ((len - 3) << 4) | (disp >> 8);
+      }
+      else if(len <= 0x10) // normal block
+      {
+        output[out++] = ((len - 1) << 4) | (disp >> 8);
+      }
+      else if(len <= 0x110) // extended block
+      {
+        output[out++] = (len - 0x11) >> 4;
+        output[out++] = ((len - 0x11) << 4) | (disp >> 8);
+      }
+      else // extra extended block
+      {
+        output[out++] = 0x10 | ((len - 0x111) >> 12);
+        output[out++] = (len - 0x111) >> 4;
+        output[out++] = ((len - 0x111) << 4) | (disp >> 8);
+      }
+      output[out++] = disp;
+    }
+    else
+    {
+      output[out++] = input[pos];
+      len = 1;
+    }
+
+    // every position needs to be findable for later matches
+    pos += len;
+    for(; added < pos; ++added)
+    {
+      if(insize - added >= LZ_MIN)
+        lz_insert(matcher, input, added);
+    }
+
+    mask >>= 1;
+  }
+
+  free(matcher);
+  return out;
+}
+
+/** @brief Build a Huffman tree
+ *  @param[out] nodes Tree nodes; leaves first, root last
+ *  @param[in]  freq  Symbol frequencies
+ *  @param[in]  count Number of symbols
+ *  @returns Number of nodes
+ */
+static size_t
+huff_build(huff_node *nodes, const uint32_t *freq, size_t count)
+{
+  size_t leaves = 0;
+  for(size_t i = 0; i < count; ++i)
+  {
+    if(freq[i] == 0)
+      continue;
+
+    nodes[leaves].freq   = freq[i];
+    nodes[leaves].symbol = i;
+    nodes[leaves].leaf   = true;
+    ++leaves;
+  }
+
+  // the decoder needs at least two leaves
+  while(leaves < 2)
+  {
+    nodes[leaves].freq   = 0;
+    nodes[leaves].symbol = leaves ? nodes[0].symbol : 0;
+    nodes[leaves].leaf   = true;
+    ++leaves;
+  }
+
+  // sort leaves by frequency
+  for(size_t i = 1; i < leaves; ++i)
+  {
+    huff_node node = nodes[i];
+    size_t j = i;
+    for(; j > 0 && nodes[j - 1].freq > node.freq; --j)
+      nodes[j] = nodes[j - 1];
+    nodes[j] = node;
+  }
+
+  // merge the two rarest nodes; merged nodes come out in frequency order, so
+  // the leaves and the merged nodes form two sorted queues
+  size_t leaf = 0, merged = leaves, total = leaves;
+  while(total < 2 * leaves - 1)
+  {
+    uint16_t child[2];
+    for(size_t i = 0; i < 2; ++i)
+    {
+      if(leaf < leaves && (merged == total || nodes[leaf].freq <= nodes[merged].freq))
+        child[i] = leaf++;
+      else
+        child[i] = merged++;
+    }
+
+    nodes[total].freq     = nodes[child[0]].freq + nodes[child[1]].freq;
+    nodes[total].child[0] = child[0];
+    nodes[total].child[1] = child[1];
+    nodes[total].leaf     = false;
+    nodes[child[0]].parent = nodes[child[1]].parent = total;
+    ++total;
+  }
+
+  return total;
+}
+
+/** @brief Check whether pending Huffman nodes can still be laid out
+ *  @param[in] nodes   Tree nodes
+ *  @param[in] pending Nodes whose children are yet to be placed, oldest first
+ *  @param[in] count   Number of pending nodes
+ *  @param[in] pick    Pending node to place next
+ *  @param[in] pair    Pair the picked node's children go into
+ *  @returns Whether every other pending node can still meet its deadline
+ */
+static bool
+huff_feasible(const huff_node *nodes, const uint16_t *pending, size_t count,
+              size_t pick, size_t pair)
+{
+  const huff_node *node = &nodes[pending[pick]];
+  size_t next = pair + 1;
+
+  // pending nodes are in deadline order, and the picked node's children
+  // have the latest deadline of all
+  for(size_t i = 0; i < count; ++i)
+  {
+    if(i != pick && nodes[pending[i]].index / 2 + 0x40 < next++)
+      return false;
+  }
+
+  for(size_t i = 0; i < 2; ++i)
+  {
+    if(!nodes[node->child[i]].leaf && pair + 0x40 < next++)
+      return false;
+  }
+
+  return true;
+}
+
+/** @brief Lay out a Huffman tree in the decoder's format
+ *
+ *  A node's children are stored as a pair at most 64 pairs after the node's
+ *  own pair. Pairs are placed depth first, which keeps few nodes pending,
+ *  unless that would make another pending node miss its deadline.
+ *
+ *  @param[out] tree  Encoded tree; tree[0] is the tree size
+ *  @param[in]  nodes Tree nodes
+ *  @param[in]  root  Root node
+ *  @returns Whether the tree could be laid out
+ */
+static bool
+huff_layout(uint8_t *tree, huff_node *nodes, size_t root)
+{
+  uint16_t pending[HUFF_SYMBOLS]; // nodes whose children are yet to be placed
+  size_t   numPending = 0;
+  size_t   pair = 0;
+
+  // the root sits alone in pair 0
+  nodes[root].index = 1;
+  pending[numPending++] = root;
+
+  while(numPending > 0)
+  {
+    // newest first, falling back to the earliest deadline
+    size_t pick = 0;
+    for(size_t i = numPending; i-- > 0;)
+    {
+      if(huff_feasible(nodes, pending, numPending, i, pair + 1))
+      {
+        pick = i;
+        break;
+      }
+    }
+
+    huff_node *node = &nodes[pending[pick]];
+    memmove(&pending[pick], &pending[pick + 1],
+            (numPending - pick - 1) * sizeof(pending[0]));
+    --numPending;
+
+    size_t offset = pair - node->index / 2;
+    if(offset > 0x3F || ++pair >= HUFF_SYMBOLS)
+      return false;
+
+    // store the child pair offset and which children are data
+    tree[node->index] = offset;
+    for(size_t i = 0; i < 2; ++i)
+    {
+      huff_node *child = &nodes[node->child[i]];
+      child->index = 2 * pair + i;
+
+      if(child->leaf)
+      {
+        tree[node->index] |= i ? 0x40 : 0x80;
+        tree[child->index] = child->symbol;
+      }
+      else
+        pending[numPending++] = node->child[i];
+    }
+  }
+
+  tree[0] = pair;
+  return true;
+}
+
+/** @brief Compress Huffman
+ *  @param[in]  bits    Data size in bits
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress
+ *  @param[in]  insize  Data size
+ *  @returns Compressed size
+ *  @retval -1 error
+ */
+static ssize_t
+compress_huff(size_t bits, uint8_t *output, size_t outsize,
+              const uint8_t *input, size_t insize)
+{
+  if(bits < 1 || bits > 8)
+    return -1;
+
+  uint32_t freq[HUFF_SYMBOLS] = { 0 };
+  for(size_t i = 0; i < insize; ++i)
+  {
+    // every byte must fit in a symbol
+    if(input[i] >> bits)
+      return -1;
+    ++freq[input[i]];
+  }
+
+  size_t out = compress_header(output, outsize, DECOMPRESS_HUFF1 + bits - 1,
+                               insize);
+  if(out == 0)
+    return -1;
+
+  huff_encoder *enc = (huff_encoder*)calloc(1, sizeof(*enc));
+  if(!enc)
+    return -1;
+
+  huff_node *nodes = enc->nodes;
+  uint8_t   tree[2 * HUFF_SYMBOLS];
+  size_t    count;
+
+  // flatten the frequencies until the tree fits the decoder's format
+  while(true)
+  {
+    count = huff_build(nodes, freq, 1 << bits);
+    if(huff_layout(tree, nodes, count - 1))
+      break;
+
+    bool flat = true;
+    for(size_t i = 0; i < HUFF_SYMBOLS; ++i)
+    {
+      if(freq[i] > 1)
+      {
+        freq[i] = (freq[i] + 1) / 2;
+        flat = false;
+      }
+    }
+
+    if(flat)
+    {
+      free(enc);
+      return -1;
+    }
+  }
+
+  // collect each symbol's code, most significant bit first
+  uint32_t (*code)[8] = enc->code;
+  uint8_t  *length    = enc->length;
+  for(size_t i = 0; i < count; ++i)
+  {
+    if(!nodes[i].leaf || length[nodes[i].symbol])
+      continue;
+
+    // walk up from the leaf to the root
+    size_t node = i, len = 0;
+    uint8_t path[HUFF_SYMBOLS];
+    while(node != count - 1)
+    {
+      size_t parent = nodes[node].parent;
+      path[len++] = nodes[parent].child[1] == node;
+      node = parent;
+    }
+
+    length[nodes[i].symbol] = len;
+    for(size_t j = 0; j < len; ++j)
+    {
+      if(path[len - 1 - j])
+        code[nodes[i].symbol][j / 32] |= 0x80000000U >> (j % 32);
+    }
+  }
+
+  size_t treeSize = ((size_t)tree[0] + 1) * 2;
+  if(outsize - out < treeSize)
+  {
+    free(enc);
+    return -1;
+  }
+
+  memcpy(&output[out], tree, treeSize);
+  out += treeSize;
+
+  // pack codes into 32-bit little-endian words, bit 31 first
+  uint32_t word = 0;
+  size_t   used = 0;
+  for(size_t i = 0; i < insize; ++i)
+  {
+    uint8_t symbol = input[i];
+    for(size_t j = 0; j < length[symbol]; ++j)
+    {
+      if(code[symbol][j / 32] & (0x80000000U >> (j % 32)))
+        word |= 0x80000000U >> used;
+
+      if(++used == 32)
+      {
+        if(outsize - out < 4)
+        {
+          free(enc);
+          return -1;
+        }
+
+        write_u32(&output[out], word);
+        out += 4;
+        word = 0;
+        used = 0;
+      }
+    }
+  }
+
+  free(enc);
+
+  if(used > 0)
+  {
+    if(outsize - out < 4)
+      return -1;
+
+    write_u32(&output[out], word);
+    out += 4;
+  }
+
+  return out;
+}
+
+/** @brief Compress run-length encoding
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress
+ *  @param[in]  insize  Data size
+ *  @returns Compressed size
+ *  @retval -1 error
+ */
+static ssize_t
+compress_rle(uint8_t *output, size_t outsize, const uint8_t *input,
+             size_t insize)
+{
+  size_t out = compress_header(output, outsize, DECOMPRESS_RLE, insize);
+  if(out == 0)
+    return -1;
+
+  size_t pos = 0, literal = 0; // literal: start of pending raw bytes
+
+  while(pos <= insize)
+  {
+    size_t run = 1;
+    if(pos < insize)
+    {
+      while(run < 0x82 && pos + run < insize && input[pos + run] == input[pos])
+        ++run;
+    }
+
+    // flush raw bytes before a run, at the end, or when the block is full
+    if(pos - literal == 0x80 || (pos > literal && (run >= 3 || pos == insize)))
+    {
+      size_t len = pos - literal;
+      if(outsize - out < len + 1)
+        return -1;
+
+      output[out++] = len - 1;
+      memcpy(&output[out], &input[literal], len);
+      out += len;
+      literal = pos;
+    }
+
+    if(pos == insize)
+      break;
+
+    if(run >= 3) // compressed block
+    {
+      if(outsize - out < 2)
+        return -1;
+
+      output[out++] = 0x80 | (run - 3);
+      output[out++] = input[pos];
+      pos += run;
+      literal = pos;
+    }
+    else
+      ++pos;
+  }
+
+  return out;
+}
+
+ssize_t
+compress_LZSS(void *output, size_t outsize, const void *input, size_t insize,
+              int level)
+{
+  return compress_lz((uint8_t*)output, outsize, (const uint8_t*)input, insize,
+                     DECOMPRESS_LZSS, level);
+}
+
+ssize_t
+compress_LZ11(void *output, size_t outsize, const void *input, size_t insize,
+              int level)
+{
+  return compress_lz((uint8_t*)output, outsize, (const uint8_t*)input, insize,
+                     DECOMPRESS_LZ11, level);
+}
+
+ssize_t
+compress_Huff(size_t bits, void *output, size_t outsize, const void *input,
+              size_t insize)
+{
+  return compress_huff(bits, (uint8_t*)output, outsize,
+                       (const uint8_t*)input, insize);
+}
+
+ssize_t
+compress_RLE(void *output, size_t outsize, const void *input, size_t insize)
+{
+  return compress_rle((uint8_t*)output, outsize, (const uint8_t*)input,
+                      insize);
+}
+
+/** @brief Compress data
+ *  @param[in]  type    Compression type
+ *  @param[out] output  Output buffer
+ *  @param[in]  outsize Output buffer size
+ *  @param[in]  input   Data to compress
+ *  @param[in]  insize  Data size
+ *  @param[in]  level   Compression level
+ *  @returns Compressed size
+ *  @retval -1 error
+ */
+static ssize_t
+compress_type(decompressType type, void *output, size_t outsize,
+              const void *input, size_t insize, int level)
+{
+  switch(type)
+  {
+    case DECOMPRESS_LZSS:
+      return compress_LZSS(output, outsize, input, insize, level);
+
+    case DECOMPRESS_LZ11:
+      return compress_LZ11(output, outsize, input, insize, level);
+
+    case DECOMPRESS_HUFF1:
+    case DECOMPRESS_HUFF2:
+    case DECOMPRESS_HUFF3:
+    case DECOMPRESS_HUFF4:
+    case DECOMPRESS_HUFF5:
+    case DECOMPRESS_HUFF6:
+    case DECOMPRESS_HUFF7:
+    case DECOMPRESS_HUFF8:
+      return compress_Huff(type & 0xF, output, outsize, input, insize);
+
+    case DECOMPRESS_RLE:
+      return compress_RLE(output, outsize, input, insize);
+
+    default:
+      return -1;
+  }
+}
+
+ssize_t
+compressChunked(void *output, size_t outsize, const void *input,
+                size_t insize, size_t chunkSize, decompressType type)
+{
+  if(chunkSize == 0 || chunkSize > UINT32_MAX || type == DECOMPRESS_DUMMY
+  || type == DECOMPRESS_CHUNKED)
+    return -1;
+
+  uint8_t       *out   = (uint8_t*)output;
+  const uint8_t *in    = (const uint8_t*)input;
+  size_t        count  = insize / chunkSize + (insize % chunkSize != 0);
+  size_t        header = compress_header(out, outsize, DECOMPRESS_CHUNKED, insize);
+  if(header == 0 || (outsize - header) / 4 < count + 3)
+    return -1;
+
+  uint8_t *index = out + header + 8;
+  uint8_t *data  = index + (count + 1) * 4;
+  size_t  avail  = outsize - (data - out);
+  size_t  pos    = 0;
+
+  write_u32(out + header, chunkSize);
+  write_u32(out + header + 4, count);
+
+  for(size_t i = 0; i < count; ++i)
+  {
+    size_t len = insize - i * chunkSize;
+    if(len > chunkSize)
+      len = chunkSize;
+
+    write_u32(&index[i * 4], pos);
+
+    const uint8_t *chunk = in + i * chunkSize;
+    ssize_t bytes = compress_type(type, data + pos, avail - pos, chunk, len,
+                                  COMPRESS_LEVEL_DEFAULT);
+
+    // store chunks which don't shrink as they are
+    size_t raw = (len > 0xFFFFFF ? 8 : 4) + len;
+    if(bytes < 0 || (size_t)bytes >= raw)
+    {
+      if(avail - pos < raw)
+        return -1;
+
+      size_t bytesHeader = compress_header(data + pos, avail - pos,
+                                           DECOMPRESS_DUMMY, len);
+      memcpy(data + pos + bytesHeader, chunk, len);
+      bytes = raw;
+    }
+
+    pos += bytes;
+  }
+
+  write_u32(&index[count * 4], pos);
+  return data + pos - out;
+}
@@ -3,6 +3,7 @@
  */
 #include <3ds/util/decompress.h>
 #include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -347,6 +348,112 @@ iov_memset(iov_iter *out, char val, size_t size)
   }
 }
 
+/** @brief Copy an LZ back-reference within a contiguous output buffer
+ *  @param[in] out  Output position
+ *  @param[in] dist Distance back to the source data
+ *  @param[in] len  Length to copy
+ */
+static inline void
+lz_copy(uint8_t *out, size_t dist, size_t len)
+{
+  const uint8_t *in = out - dist;
+
+  if(dist >= len && len > 32) // long copy with no overlap
+  {
+    memcpy(out, in, len);
+    return;
+  }
+
+  if(dist >= sizeof(uint32_t))
+  {
+    // each word only reads bytes that are already written
+    while(len >= sizeof(uint32_t))
+    {
+      memcpy(out, in, sizeof(uint32_t));
+      out += sizeof(uint32_t);
+      in  += sizeof(uint32_t);
+      len -= sizeof(uint32_t);
+    }
+  }
+  else if(dist == 1) // run of a single byte
+  {
+    memset(out, *in, len);
+    return;
+  }
+  else if(len > dist)
+  {
+    // replicate the pattern, doubling the copy size each time
+    memcpy(out, in, dist);
+    size_t done = dist;
+    while(done < len)
+    {
+      size_t bytes = len - done < done ? len - done : done;
+      memcpy(out + done, out, bytes);
+      done += bytes;
+    }
+    return;
+  }
+
+  while(len-- > 0)
+    *out++ = *in++;
+}
+
+/** @brief Decompress LZSS/LZ10 from memory into a contiguous buffer
+ *  @param[in] buffer Decompression buffer object (in memory)
+ *  @param[in] output Output buffer
+ *  @param[in] size   Output size limit
+ *  @returns Whether succeeded
+ */
+static bool
+decompress_lzss_memory(buffer_t *buffer, uint8_t *output, size_t size)
+{
+  const uint8_t *in    = buffer->data + buffer->pos;
+  const uint8_t *inend = buffer->data + buffer->size;
+  uint8_t       *out   = output;
+  uint8_t       *end   = output + size;
+
+  while(out < end)
+  {
+    if(in >= inend)
+      return false;
+
+    // read in the flags data
+    uint8_t flags = *in++;
+
+    for(int i = 0; i < 8 && out < end; i++, flags <<= 1)
+    {
+      if(flags & 0x80) // compressed block
+      {
+        if(inend - in < 2)
+          return false;
+
+        size_t len  = (in[0] >> 4) + 3;
+        size_t disp = ((in[0] & 0x0F) << 8 | in[1]) + 1;
+        in += 2;
+
+        if(disp > (size_t)(out - output))
+          return false;
+
+        if(len > (size_t)(end - out))
+          len = end - out;
+
+        lz_copy(out, disp, len);
+        out += len;
+      }
+      else // uncompressed block
+      {
+        if(in >= inend)
+          return false;
+
+        *out++ = *in++;
+      }
+    }
+  }
+
+  buffer->pos = in - buffer->data;
+  return true;
+}
+
 /** @brief Decompress LZSS/LZ10
  *  @param[in] buffer   Decompression buffer object
  *  @param[in] iov      Output vector
@@ -366,6 +473,10 @@ decompress_lzss(buffer_t *buffer, const decompressIOVec *iov, size_t iovcnt,
   unsigned int len;
   unsigned int disp;
 
+  // fast-path; whole input in memory and a single output buffer
+  if(!callback && iovcnt == 1)
+    return decompress_lzss_memory(buffer, (uint8_t*)iov[0].data, size);
+
   while(size > 0)
   {
     if(mask == 0)
@@ -417,6 +528,89 @@ decompress_lzss(buffer_t *buffer, const decompressIOVec *iov, size_t iovcnt,
   return true;
 }
 
+/** @brief Decompress LZ11 from memory into a contiguous buffer
+ *  @param[in] buffer Decompression buffer object (in memory)
+ *  @param[in] output Output buffer
+ *  @param[in] size   Output size limit
+ *  @returns Whether succeeded
+ */
+static bool
+decompress_lz11_memory(buffer_t *buffer, uint8_t *output, size_t size)
+{
+  const uint8_t *in    = buffer->data + buffer->pos;
+  const uint8_t *inend = buffer->data + buffer->size;
+  uint8_t       *out   = output;
+  uint8_t       *end   = output + size;
+
+  while(out < end)
+  {
+    if(in >= inend)
+      return false;
+
+    // read in the flags data
+    uint8_t flags = *in++;
+
+    for(int i = 0; i < 8 && out < end; i++, flags <<= 1)
+    {
+      if(flags & 0x80) // compressed block
+      {
+        if(in >= inend)
+          return false;
+
+        size_t len;
+
+        switch(in[0] >> 4)
+        {
+          case 0: // extended block
+            if(inend - in < 3)
+              return false;
+
+            len = ((in[0] << 4) | (in[1] >> 4)) + 0x11;
+            in += 1;
+            break;
+
+          case 1: // extra extended block
+            if(inend - in < 4)
+              return false;
+
+            len = (((in[0] & 0x0F) << 12) | (in[1] << 4) | (in[2] >> 4)) + 0x111;
+            in += 2;
+            break;
+
+          default: // normal block
+            if(inend - in < 2)
+              return false;
+
+            len = (in[0] >> 4) + 1;
+            break;
+        }
+
+        size_t disp = ((in[0] & 0x0F) << 8 | in[1]) + 1;
+        in += 2;
+
+        if(disp > (size_t)(out - output))
+          return false;
+
+        if(len > (size_t)(end - out))
+          len = end - out;
+
+        lz_copy(out, disp, len);
+        out += len;
+      }
+      else // uncompressed block
+      {
+        if(in >= inend)
+          return false;
+
+        *out++ = *in++;
+      }
+    }
+  }
+
+  buffer->pos = in - buffer->data;
+  return true;
+}
+
 /** @brief Decompress LZ11
  *  @param[in] buffer   Decompression buffer object
  *  @param[in] iov      Output vector
@@ -434,6 +628,10 @@ decompress_lz11(buffer_t *buffer, const decompressIOVec *iov, size_t iovcnt,
   int      i;
   uint8_t  flags;
 
+  // fast-path; whole input in memory and a single output buffer
+  if(!callback && iovcnt == 1)
+    return decompress_lz11_memory(buffer, (uint8_t*)iov[0].data, size);
+
   while(size > 0)
   {
     // read in the flags data
@@ -513,6 +711,102 @@ decompress_lz11(buffer_t *buffer, const decompressIOVec *iov, size_t iovcnt,
   return true;
 }
 
+/** @brief Huffman tree size */
+#define HUFF_TREE_SIZE    512
+/** @brief Number of bitstream bits resolved by one lookup table probe */
+#define HUFF_LOOKUP_BITS  9
+/** @brief Lookup table entry flag for a decoded symbol */
+#define HUFF_LOOKUP_LEAF  0x8000
+
+/** @brief Huffman decoding state */
+typedef struct
+{
+  uint8_t  tree[HUFF_TREE_SIZE];            ///< Huffman tree
+  uint16_t table[1 << HUFF_LOOKUP_BITS];    ///< Lookup table
+} huff_t;
+
+/** @brief Fill Huffman lookup table entries below a tree node
+ *
+ *  Each table entry is indexed by the next HUFF_LOOKUP_BITS bits of the
+ *  bitstream and holds either a symbol and its code length, the node reached
+ *  after consuming all HUFF_LOOKUP_BITS bits, or 0 if the tree is corrupt.
+ *
+ *  @param[in] huff     Huffman decoding state
+ *  @param[in] node     Tree node
+ *  @param[in] depth    Depth of node
+ *  @param[in] prefix   Code leading to node
+ *  @param[in] dataMask Mask to apply to data
+ */
+static void
+huff_fill(huff_t *huff, size_t node, size_t depth, size_t prefix,
+          uint8_t dataMask)
+{
+  size_t child = (node & ~1) + (huff->tree[node] & 0x3F)*2 + 2;
+
+  for(size_t bit = 0; bit < 2; ++bit, ++child)
+  {
+    size_t   len   = depth + 1;
+    size_t   code  = (prefix << 1) | bit;
+    size_t   shift = HUFF_LOOKUP_BITS - len;
+    uint16_t entry;
+
+    if(child >= HUFF_TREE_SIZE) // corrupt tree
+      entry = 0;
+    else if(huff->tree[node] & (bit ? 0x40 : 0x80)) // data node
+      entry = HUFF_LOOKUP_LEAF | (len << 8) | (huff->tree[child] & dataMask);
+    else if(len == HUFF_LOOKUP_BITS) // continue bit by bit
+      entry = child;
+    else
+    {
+      huff_fill(huff, child, len, code, dataMask);
+      continue;
+    }
+
+    for(size_t i = 0; i < ((size_t)1 << shift); ++i)
+      huff->table[(code << shift) | i] = entry;
+  }
+}
+
+/** @brief Refill Huffman bitstream
+ *  @param[in]    buffer   Decompression buffer object
+ *  @param[inout] bits     Bitstream, most significant bit first
+ *  @param[inout] avail    Number of valid bits in bitstream
+ *  @param[inout] eof      Whether the input is exhausted
+ *  @param[in]    callback Data callback
+ *  @param[in]    userdata User data passed to callback
+ */
+static inline void
+huff_refill(buffer_t *buffer, uint64_t *bits, size_t *avail, bool *eof,
+            decompressCallback callback, void *userdata)
+{
+  if(*eof || *avail > 32)
+    return;
+
+  uint8_t wordbuf[4];
+  const uint8_t *p = wordbuf;
+
+  // fast-path; read the word in place if we have it
+  if(buffer->size - buffer->pos >= 4)
+  {
+    p = buffer->data + buffer->pos;
+    buffer->pos += 4;
+  }
+  else if(!buffer_read(buffer, wordbuf, 4, callback, userdata))
+  {
+    // only an error if a bit is actually needed from this word
+    *eof = true;
+    return;
+  }
+
+  uint32_t word = (p[0] <<  0)
+                | (p[1] <<  8)
+                | (p[2] << 16)
+                | ((uint32_t)p[3] << 24);
+
+  *bits  |= (uint64_t)word << (32 - *avail);
+  *avail += 32;
+}
+
 /** @brief Decompress Huffman
  *  @param[in] bits     Data size in bits (usually 4 or 8)
  *  @param[in] buffer   Decompression buffer object
@@ -531,105 +825,92 @@ decompress_huff(const size_t bits, buffer_t *buffer, const decompressIOVec *iov,
   if(bits < 1 || bits > 8)
     return false;
 
-  uint8_t *tree = (uint8_t*)malloc(512);
-  if(!tree)
-    return false;
+  huff_t huff;
+  uint8_t *tree = huff.tree;
 
   // get tree size
   if(!buffer_read(buffer, &tree[0], 1, callback, userdata))
-  {
-    free(tree);
     return false;
-  }
 
   // read tree
-  if(!buffer_read(buffer, &tree[1], (((size_t)tree[0])+1)*2-1, callback, userdata))
-  {
-    free(tree);
+  size_t treeSize = (((size_t)tree[0])+1)*2;
+  if(!buffer_read(buffer, &tree[1], treeSize-1, callback, userdata))
     return false;
-  }
+
+  memset(&tree[treeSize], 0, HUFF_TREE_SIZE - treeSize);
 
   iov_iter out = iov_begin(iov, iovcnt);
-  uint32_t word = 0;               // 32-bits of input bitstream
-  uint32_t mask = 0;               // which bit we are reading
-  uint8_t  dataMask = (1<<bits)-1; // mask to apply to data
-  size_t   node;                   // node in the huffman tree
-  size_t   child;                  // child of a node
-  uint32_t offset;                 // offset from node to child
+  uint64_t stream   = 0;               // input bitstream, read bit 63 first
+  size_t   avail    = 0;               // number of bits in stream
+  bool     eof      = false;           // whether the input is exhausted
+  uint8_t  dataMask = (1<<bits)-1;     // mask to apply to data
+  size_t   node;                       // node in the huffman tree
+  size_t   child;                      // child of a node
 
-  // point to the root of the huffman tree
-  node = 1;
+  // resolve the first HUFF_LOOKUP_BITS levels of the tree up front
+  huff_fill(&huff, 1, 0, 0, dataMask);
 
   while(size > 0)
   {
-    if(mask == 0) // we exhausted 32 bits
-    {
-      // reset the mask
-      mask = 0x80000000;
-
-      // read the next 32 bits
-      uint8_t wordbuf[4];
-      if(!buffer_get(buffer, &wordbuf[0], callback, userdata)
-      || !buffer_get(buffer, &wordbuf[1], callback, userdata)
-      || !buffer_get(buffer, &wordbuf[2], callback, userdata)
-      || !buffer_get(buffer, &wordbuf[3], callback, userdata))
-      {
-        free(tree);
-        return false;
-      }
-
-      word = (wordbuf[0] <<  0)
-           | (wordbuf[1] <<  8)
-           | (wordbuf[2] << 16)
-           | (wordbuf[3] << 24);
-    }
+    huff_refill(buffer, &stream, &avail, &eof, callback, userdata);
 
-    // read the current node's offset value
-    offset = tree[node] & 0x3F;
+    // point to the root of the huffman tree
+    node = 1;
 
-    child = (node & ~1) + offset*2 + 2;
-
-    if(word & mask) // we read a 1
+    if(avail >= HUFF_LOOKUP_BITS)
     {
-      // point to the "right" child
-      ++child;
+      uint16_t entry = huff.table[stream >> (64 - HUFF_LOOKUP_BITS)];
 
-      if(tree[node] & 0x40) // "right" child is a data node
+      if(entry & HUFF_LOOKUP_LEAF) // whole code resolved
       {
-        // copy the child node into the output buffer and apply mask
-        *iov_addr(&out) = tree[child] & dataMask;
+        *iov_addr(&out) = entry & 0xFF;
         iov_increment(&out);
         --size;
 
-        // start over at the root node
-        node = 1;
+        size_t len = (entry >> 8) & 0xF;
+        stream <<= len;
+        avail   -= len;
+        continue;
       }
-      else // traverse to the "right" child
-        node = child;
+
+      if(entry == 0)
+        return false;
+
+      // long code; carry on from where the table left off
+      node    = entry;
+      stream <<= HUFF_LOOKUP_BITS;
+      avail   -= HUFF_LOOKUP_BITS;
     }
-    else // we read a 0
+
+    while(true)
     {
-      // pointed to the "left" child
+      if(avail == 0)
+      {
+        huff_refill(buffer, &stream, &avail, &eof, callback, userdata);
+        if(avail == 0)
+          return false;
+      }
 
-      if(tree[node] & 0x80) // "left" child is a data node
+      uint8_t flag = (stream >> 63) ? 0x40 : 0x80;
+      child = (node & ~1) + (tree[node] & 0x3F)*2 + 2 + (flag == 0x40);
+      stream <<= 1;
+      --avail;
+
+      if(child >= HUFF_TREE_SIZE)
+        return false;
+
+      if(tree[node] & flag) // data node
       {
-        // copy the child node into the output buffer and apply mask
         *iov_addr(&out) = tree[child] & dataMask;
         iov_increment(&out);
         --size;
-
-        // start over at the root node
-        node = 1;
+        break;
       }
-      else // traverse to the "left" child
-        node = child;
-    }
 
-    // shift to read next bit (read bit 31 to bit 0)
-    mask >>= 1;
+      node = child;
+    }
   }
 
-  free(tree);
   return true;
 }
 
@@ -805,6 +1086,14 @@ decompressV(const decompressIOVec *iov, size_t iovcnt,
     case DECOMPRESS_RLE:
       result = decompress_rle(&buffer, iov, iovcnt, size, callback, userdata);
       break;
+
+    case DECOMPRESS_CHUNKED:
+      // the chunk index needs random access
+      if(!callback && iovcnt == 1)
+        result = decompressParallel(iov[0].data, size,
+                                    (uint8_t*)userdata - bytes, insize + bytes,
+                                    1);
+      break;
   }
 
   if(callback)
@@ -883,3 +1172,507 @@ decompressV_RLE(const decompressIOVec *iov, size_t iovcnt,
     buffer_destroy(&buffer);
   return result;
 }
+
+/** @brief Streaming back-reference window size */
+#define STREAM_WINDOW 0x1000
+
+/** @brief Streaming decompression output modes */
+enum
+{
+  STREAM_COPY_NONE,    ///< Nothing pending
+  STREAM_COPY_MATCH,   ///< Copy from the window
+  STREAM_COPY_RUN,     ///< Repeat a byte
+  STREAM_COPY_LITERAL, ///< Copy from the input
+};
+
+/** @brief Streaming decompression state */
+struct decompressStream
+{
+  decompressType type;          ///< Decompression type
+  size_t   outSize;             ///< Decompressed size
+  size_t   size;                ///< Output left to produce
+  size_t   total;               ///< Output produced, up to STREAM_WINDOW
+  bool     started;             ///< Whether the header has been read
+  bool     error;               ///< Whether the data is corrupt
+  uint8_t  header[8];           ///< Compression header
+  size_t   headerLen;           ///< Compression header bytes read
+  uint8_t  flags;               ///< LZ flags
+  size_t   flagCount;           ///< LZ blocks left for flags
+  uint8_t  token[4];            ///< Partially read block
+  size_t   tokenLen;            ///< Partially read block size
+  int      mode;                ///< Pending output mode
+  size_t   copyLen;             ///< Pending output size
+  size_t   copyDist;            ///< Back-reference distance
+  uint8_t  runByte;             ///< Byte to repeat
+  size_t   treeLen;             ///< Huffman tree bytes read
+  size_t   treeSize;            ///< Huffman tree size
+  uint8_t  dataMask;            ///< Huffman data mask
+  size_t   node;                ///< Huffman tree node
+  uint64_t bits;                ///< Huffman bitstream, read bit 63 first
+  size_t   avail;               ///< Number of bits in bitstream
+  uint8_t  word[4];             ///< Partially read bitstream word
+  size_t   wordLen;             ///< Partially read bitstream word size
+  size_t   winPos;              ///< Window position
+  uint8_t  window[STREAM_WINDOW]; ///< Back-reference window
+  huff_t   huff;                ///< Huffman tree and lookup table
+};
+
+/** @brief Stream I/O state for one decompressStreamFeed() call */
+typedef struct
+{
+  const uint8_t *in;     ///< Input position
+  const uint8_t *inEnd;  ///< Input end
+  uint8_t       *out;    ///< Output position
+  uint8_t       *outEnd; ///< Output end
+} stream_io;
+
+/** @brief Output a byte from a stream
+ *  @param[in] stream Stream state
+ *  @param[in] io     Stream I/O state
+ *  @param[in] byte   Byte to output
+ */
+static inline void
+stream_put(decompressStream *stream, stream_io *io, uint8_t byte)
+{
+  *io->out++ = byte;
+  stream->window[stream->winPos] = byte;
+  stream->winPos = (stream->winPos + 1) & (STREAM_WINDOW - 1);
+  if(stream->total < STREAM_WINDOW)
+    ++stream->total;
+  --stream->size;
+}
+
+/** @brief Queue stream output
+ *  @param[in] stream Stream state
+ *  @param[in] mode   Output mode
+ *  @param[in] len    Output size
+ */
+static inline void
+stream_queue(decompressStream *stream, int mode, size_t len)
+{
+  stream->mode    = mode;
+  stream->copyLen = len < stream->size ? len : stream->size;
+}
+
+/** @brief Produce pending stream output
+ *  @param[in] stream Stream state
+ *  @param[in] io     Stream I/O state
+ *  @returns Whether all pending output was produced
+ */
+static bool
+stream_flush(decompressStream *stream, stream_io *io)
+{
+  while(stream->copyLen > 0)
+  {
+    if(io->out == io->outEnd)
+      return false;
+
+    switch(stream->mode)
+    {
+      case STREAM_COPY_MATCH:
+        stream_put(stream, io, stream->window[(stream->winPos - stream->copyDist)
+                                              & (STREAM_WINDOW - 1)]);
+        break;
+
+      case STREAM_COPY_RUN:
+        stream_put(stream, io, stream->runByte);
+        break;
+
+      case STREAM_COPY_LITERAL:
+        if(io->in == io->inEnd)
+          return false;
+        stream_put(stream, io, *io->in++);
+        break;
+    }
+
+    --stream->copyLen;
+  }
+
+  stream->mode = STREAM_COPY_NONE;
+  return true;
+}
+
+/** @brief Read part of a block from a stream
+ *  @param[in] stream Stream state
+ *  @param[in] io     Stream I/O state
+ *  @param[in] len    Block size
+ *  @returns Whether the whole block has been read
+ */
+static bool
+stream_token(decompressStream *stream, stream_io *io, size_t len)
+{
+  while(stream->tokenLen < len)
+  {
+    if(io->in == io->inEnd)
+      return false;
+    stream->token[stream->tokenLen++] = *io->in++;
+  }
+
+  return true;
+}
+
+/** @brief Queue a back-reference
+ *  @param[in] stream Stream state
+ *  @param[in] len    Length
+ *  @param[in] disp   Displacement
+ *  @returns Whether the back-reference is valid
+ */
+static bool
+stream_match(decompressStream *stream, size_t len, size_t disp)
+{
+  if(disp + 1 > stream->total)
+    return false;
+
+  stream->copyDist = disp + 1;
+  stream_queue(stream, STREAM_COPY_MATCH, len);
+  return true;
+}
+
+/** @brief Decode the next LZSS/LZ11 block of a stream
+ *  @param[in] stream Stream state
+ *  @param[in] io     Stream I/O state
+ *  @returns 1 if a block was decoded, 0 if more input is needed, -1 on error
+ */
+static int
+stream_lz(decompressStream *stream, stream_io *io)
+{
+  if(stream->flagCount == 0)
+  {
+    if(io->in == io->inEnd)
+      return 0;
+
+    stream->flags     = *io->in++;
+    stream->flagCount = 8;
+  }
+
+  if(!(stream->flags & 0x80)) // uncompressed block
+  {
+    stream_queue(stream, STREAM_COPY_LITERAL, 1);
+  }
+  else if(stream->type == DECOMPRESS_LZSS)
+  {
+    if(!stream_token(stream, io, 2))
+      return 0;
+
+    stream->tokenLen = 0;
+    size_t len  = ((stream->token[0] & 0xF0) >> 4) + 3;
+    size_t disp = (stream->token[0] & 0x0F) << 8 | stream->token[1];
+    if(!stream_match(stream, len, disp))
+      return -1;
+  }
+  else // LZ11
+  {
+    if(!stream_token(stream, io, 1))
+      return 0;
+
+    // the first byte of the block gives its size
+    uint8_t *t = stream->token;
+    size_t need = (t[0] >> 4) == 0 ? 3 : (t[0] >> 4) == 1 ? 4 : 2;
+    if(!stream_token(stream, io, need))
+      return 0;
+
+    stream->tokenLen = 0;
+
+    size_t len;
+    switch(t[0] >> 4)
+    {
+      case 0: // extended block
+        len = ((t[0] << 4) | (t[1] >> 4)) + 0x11;
+        t  += 1;
+        break;
+
+      case 1: // extra extended block
+        len = (((t[0] & 0x0F) << 12) | (t[1] << 4) | (t[2] >> 4)) + 0x111;
+        t  += 2;
+        break;
+
+      default: // normal block
+        len = (t[0] >> 4) + 1;
+        break;
+    }
+
+    if(!stream_match(stream, len, (t[0] & 0x0F) << 8 | t[1]))
+      return -1;
+  }
+
+  stream->flags <<= 1;
+  --stream->flagCount;
+  return 1;
+}
+
+/** @brief Decode the next RLE block of a stream
+ *  @param[in] stream Stream state
+ *  @param[in] io     Stream I/O state
+ *  @returns 1 if a block was decoded, 0 if more input is needed
+ */
+static int
+stream_rle(decompressStream *stream, stream_io *io)
+{
+  if(!stream_token(stream, io, 1))
+    return 0;
+
+  if(!(stream->token[0] & 0x80)) // uncompressed block
+  {
+    stream->tokenLen = 0;
+    stream_queue(stream, STREAM_COPY_LITERAL, (stream->token[0] & 0x7F) + 1);
+    return 1;
+  }
+
+  // compressed block; wait for the byte used for the run
+  if(!stream_token(stream, io, 2))
+    return 0;
+
+  stream->tokenLen = 0;
+
+  stream->runByte = stream->token[1];
+  stream_queue(stream, STREAM_COPY_RUN, (stream->token[0] & 0x7F) + 3);
+  return 1;
+}
+
+/** @brief Decode Huffman symbols from a stream
+ *  @param[in] stream Stream state
+ *  @param[in] io     Stream I/O state
+ *  @returns 1 if progress was made, 0 if more input or output is needed, -1
+ *           on error
+ */
+static int
+stream_huff(decompressStream *stream, stream_io *io)
+{
+  huff_t *huff = &stream->huff;
+
+  if(stream->treeLen < stream->treeSize)
+  {
+    // read the tree, starting with its size
+    while(stream->treeLen < stream->treeSize)
+    {
+      if(io->in == io->inEnd)
+        return 0;
+
+      huff->tree[stream->treeLen++] = *io->in++;
+      if(stream->treeLen == 1)
+        stream->treeSize = (((size_t)huff->tree[0])+1)*2;
+    }
+
+    memset(&huff->tree[stream->treeSize], 0, HUFF_TREE_SIZE - stream->treeSize);
+    huff_fill(huff, 1, 0, 0, stream->dataMask);
+    stream->node = 1;
+  }
+
+  int progress = 0;
+  while(stream->size > 0 && io->out < io->outEnd)
+  {
+    // keep a lookup's worth of bits around while the input lasts
+    while(stream->avail < HUFF_LOOKUP_BITS && io->in < io->inEnd)
+    {
+      stream->word[stream->wordLen++] = *io->in++;
+      if(stream->wordLen == 4)
+      {
+        uint32_t word = (stream->word[0] <<  0)
+                      | (stream->word[1] <<  8)
+                      | (stream->word[2] << 16)
+                      | ((uint32_t)stream->word[3] << 24);
+
+        stream->bits   |= (uint64_t)word << (32 - stream->avail);
+        stream->avail  += 32;
+        stream->wordLen = 0;
+      }
+    }
+
+    if(stream->node == 1 && stream->avail >= HUFF_LOOKUP_BITS)
+    {
+      uint16_t entry = huff->table[stream->bits >> (64 - HUFF_LOOKUP_BITS)];
+
+      if(entry == 0)
+        return -1;
+
+      if(entry & HUFF_LOOKUP_LEAF)
+      {
+        size_t len = (entry >> 8) & 0xF;
+        stream_put(stream, io, entry & 0xFF);
+        stream->bits <<= len;
+        stream->avail -= len;
+      }
+      else
+      {
+        stream->node   = entry;
+        stream->bits <<= HUFF_LOOKUP_BITS;
+        stream->avail -= HUFF_LOOKUP_BITS;
+      }
+
+      progress = 1;
+      continue;
+    }
+
+    if(stream->avail == 0)
+      break;
+
+    // walk the tree a bit at a time
+    size_t  node  = stream->node;
+    uint8_t flag  = (stream->bits >> 63) ? 0x40 : 0x80;
+    size_t  child = (node & ~1) + (huff->tree[node] & 0x3F)*2 + 2 + (flag == 0x40);
+    stream->bits <<= 1;
+    --stream->avail;
+    progress = 1;
+
+    if(child >= HUFF_TREE_SIZE)
+      return -1;
+
+    if(huff->tree[node] & flag) // data node
+    {
+      stream_put(stream, io, huff->tree[child] & stream->dataMask);
+      stream->node = 1;
+    }
+    else
+      stream->node = child;
+  }
+
+  return progress;
+}
+
+/** @brief Read the compression header of a stream
+ *  @param[in] stream Stream state
+ *  @param[in] io     Stream I/O state
+ *  @returns 1 if the header was read, 0 if more input is needed, -1 on error
+ */
+static int
+stream_header(decompressStream *stream, stream_io *io)
+{
+  size_t need = 4;
+  while(stream->headerLen < need)
+  {
+    if(io->in == io->inEnd)
+      return 0;
+
+    stream->header[stream->headerLen++] = *io->in++;
+    if(stream->header[0] & 0x80)
+      need = 8;
+  }
+
+  uint8_t *header = stream->header;
+  stream->type = header[0] & ~0x80;
+  stream->size = (header[1] <<  0)
+               | (header[2] <<  8)
+               | (header[3] << 16);
+  if(header[0] & 0x80)
+    stream->size |= (size_t)header[4] << 24;
+  stream->outSize = stream->size;
+
+  switch(stream->type)
+  {
+    case DECOMPRESS_DUMMY:
+      stream_queue(stream, STREAM_COPY_LITERAL, stream->size);
+      break;
+
+    case DECOMPRESS_LZSS:
+    case DECOMPRESS_LZ11:
+    case DECOMPRESS_RLE:
+      break;
+
+    case DECOMPRESS_HUFF1:
+    case DECOMPRESS_HUFF2:
+    case DECOMPRESS_HUFF3:
+    case DECOMPRESS_HUFF4:
+    case DECOMPRESS_HUFF5:
+    case DECOMPRESS_HUFF6:
+    case DECOMPRESS_HUFF7:
+    case DECOMPRESS_HUFF8:
+      stream->dataMask = (1 << (stream->type & 0xF)) - 1;
+      stream->treeSize = 1;
+      break;
+
+    default:
+      return -1;
+  }
+
+  stream->started = true;
+  return 1;
+}
+
+decompressStream*
+decompressStreamInit(void)
+{
+  decompressStream *stream = (decompressStream*)malloc(sizeof(*stream));
+  if(!stream)
+    return NULL;
+
+  // everything but the window and tables starts out zeroed
+  memset(stream, 0, offsetof(decompressStream, window));
+  return stream;
+}
+
+bool
+decompressStreamGetHeader(const decompressStream *stream,
+                          decompressType *type, size_t *size)
+{
+  if(!stream->started)
+    return false;
+
+  if(type)
+    *type = stream->type;
+  if(size)
+    *size = stream->outSize;
+
+  return true;
+}
+
+decompressStreamStatus
+decompressStreamFeed(decompressStream *stream, const void *in, size_t inLen,
+                     size_t *inUsed, void *out, size_t outCap,
+                     size_t *outUsed)
+{
+  stream_io io;
+  io.in     = (const uint8_t*)in;
+  io.inEnd  = io.in + inLen;
+  io.out    = (uint8_t*)out;
+  io.outEnd = io.out + outCap;
+
+  int rc = 1;
+  while(!stream->error && rc > 0)
+  {
+    if(!stream->started)
+    {
+      rc = stream_header(stream, &io);
+      continue;
+    }
+
+    if(!stream_flush(stream, &io) || stream->size == 0)
+      break;
+
+    switch(stream->type)
+    {
+      case DECOMPRESS_LZSS:
+      case DECOMPRESS_LZ11:
+        rc = stream_lz(stream, &io);
+        break;
+
+      case DECOMPRESS_RLE:
+        rc = stream_rle(stream, &io);
+        break;
+
+      default:
+        rc = stream_huff(stream, &io);
+        break;
+    }
+  }
+
+  if(rc < 0)
+    stream->error = true;
+
+  *inUsed  = io.in - (const uint8_t*)in;
+  *outUsed = io.out - (uint8_t*)out;
+
+  if(stream->error)
+    return DECOMPRESS_STREAM_ERROR;
+  if(stream->started && stream->size == 0)
+    return DECOMPRESS_STREAM_END;
+  return DECOMPRESS_STREAM_MORE;
+}
+
+bool
+decompressStreamFinish(decompressStream *stream)
+{
+  bool result = stream->started && !stream->error && stream->size == 0;
+
+  free(stream);
+  return result;
+}
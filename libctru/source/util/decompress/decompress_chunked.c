@@ -0,0 +1,223 @@
+/** @file decompress_chunked.c
+ *  @brief Chunked container decompression
+ */
+#include <3ds/types.h>
+#include <3ds/svc.h>
+#include <3ds/thread.h>
+#include <3ds/util/decompress.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHUNKED_STACK_SIZE  0x4000
+#define CHUNKED_MAX_WORKERS 4
+
+/** @brief Chunked container */
+typedef struct
+{
+  const uint8_t *index;      ///< Chunk offsets
+  const uint8_t *data;       ///< Chunk data
+  size_t        dataSize;    ///< Chunk data size
+  size_t        size;        ///< Decompressed size
+  size_t        chunkSize;   ///< Decompressed chunk size
+  size_t        chunkCount;  ///< Number of chunks
+} chunked_t;
+
+/** @brief Parallel decompression job */
+typedef struct
+{
+  const chunked_t *container; ///< Chunked container
+  uint8_t         *output;    ///< Output buffer
+  size_t          size;       ///< Output size limit
+  size_t          count;      ///< Number of chunks to decompress
+  size_t          next;       ///< Next chunk to decompress
+  bool            failed;     ///< Whether any chunk failed
+} chunked_job;
+
+/** @brief Read a little-endian 32-bit value
+ *  @param[in] data Data to read
+ *  @returns Value
+ */
+static inline uint32_t
+read_u32(const uint8_t *data)
+{
+  return (data[0] <<  0)
+       | (data[1] <<  8)
+       | (data[2] << 16)
+       | ((uint32_t)data[3] << 24);
+}
+
+/** @brief Open a chunked container
+ *  @param[out] container Chunked container
+ *  @param[in]  input     Container data
+ *  @param[in]  insize    Container data size
+ *  @returns Whether succeeded
+ */
+static bool
+chunked_open(chunked_t *container, const void *input, size_t insize)
+{
+  decompressType type;
+  size_t size;
+  ssize_t bytes = decompressHeader(&type, &size, NULL, (void*)input, insize);
+  if(bytes < 0 || type != DECOMPRESS_CHUNKED)
+    return false;
+
+  const uint8_t *in = (const uint8_t*)input + bytes;
+  insize -= bytes;
+  if(insize < 8)
+    return false;
+
+  container->size       = size;
+  container->chunkSize  = read_u32(&in[0]);
+  container->chunkCount = read_u32(&in[4]);
+  in     += 8;
+  insize -= 8;
+
+  if(container->chunkSize == 0)
+    return false;
+
+  // the chunk count must cover exactly the decompressed size
+  size_t count = size / container->chunkSize
+               + (size % container->chunkSize != 0);
+  if(container->chunkCount != count || container->chunkCount >= insize / 4)
+    return false;
+
+  container->index    = in;
+  container->data     = in + (container->chunkCount + 1) * 4;
+  container->dataSize = insize - (container->chunkCount + 1) * 4;
+
+  return true;
+}
+
+/** @brief Decompress a chunk
+ *  @param[in] container Chunked container
+ *  @param[in] chunk     Chunk number
+ *  @param[in] output    Output buffer
+ *  @param[in] size      Output size limit
+ *  @returns Whether succeeded
+ */
+static bool
+chunked_decompress(const chunked_t *container, size_t chunk, uint8_t *output,
+                   size_t size)
+{
+  size_t start = read_u32(&container->index[chunk * 4]);
+  size_t end   = read_u32(&container->index[chunk * 4 + 4]);
+  if(start > end || end > container->dataSize)
+    return false;
+
+  size_t len = container->size - chunk * container->chunkSize;
+  if(len > container->chunkSize)
+    len = container->chunkSize;
+
+  // every chunk must hold exactly its share of the data
+  decompressType type;
+  size_t chunkSize;
+  const uint8_t *data = container->data + start;
+  if(decompressHeader(&type, &chunkSize, NULL, (void*)data, end - start) < 0
+  || type == DECOMPRESS_CHUNKED || chunkSize != len)
+    return false;
+
+  decompressIOVec iov;
+  iov.data = output;
+  iov.size = size < len ? size : len;
+
+  return decompressV(&iov, 1, NULL, (void*)data, end - start);
+}
+
+/** @brief Parallel decompression worker
+ *  @param[in] arg Parallel decompression job
+ */
+static void
+chunked_worker(void *arg)
+{
+  chunked_job *job = (chunked_job*)arg;
+  const chunked_t *container = job->container;
+  size_t chunk;
+
+  while((chunk = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->count)
+  {
+    if(__atomic_load_n(&job->failed, __ATOMIC_RELAXED))
+      break;
+
+    size_t start = chunk * container->chunkSize;
+    if(!chunked_decompress(container, chunk, job->output + start,
+                           job->size - start))
+      __atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+  }
+}
+
+bool
+decompressParallel(void *output, size_t size, const void *input,
+                   size_t insize, unsigned int numWorkers)
+{
+  chunked_t container;
+  if(!chunked_open(&container, input, insize))
+    return false;
+
+  if(size > container.size)
+    size = container.size;
+
+  chunked_job job;
+  job.container = &container;
+  job.output    = (uint8_t*)output;
+  job.size      = size;
+  job.count     = size / container.chunkSize + (size % container.chunkSize != 0);
+  job.next      = 0;
+  job.failed    = false;
+
+  if(numWorkers > CHUNKED_MAX_WORKERS)
+    numWorkers = CHUNKED_MAX_WORKERS;
+  if(numWorkers > job.count)
+    numWorkers = job.count;
+
+  s32 prio = 0x30;
+  svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+
+  // the calling thread is worker 0
+  Thread threads[CHUNKED_MAX_WORKERS - 1];
+  unsigned int numThreads = 0;
+  for(unsigned int i = 1; i < numWorkers; ++i)
+  {
+    Thread thread = threadCreate(chunked_worker, &job, CHUNKED_STACK_SIZE,
+                                 prio, i, false);
+    if(!thread)
+      thread = threadCreate(chunked_worker, &job, CHUNKED_STACK_SIZE,
+                            prio, -2, false);
+    if(!thread)
+      break;
+
+    threads[numThreads++] = thread;
+  }
+
+  chunked_worker(&job);
+
+  for(unsigned int i = 0; i < numThreads; ++i)
+  {
+    threadJoin(threads[i], U64_MAX);
+    threadFree(threads[i]);
+  }
+
+  return !job.failed;
+}
+
+ssize_t
+decompressChunkAt(void *output, size_t outsize, const void *input,
+                  size_t insize, size_t offset, size_t *chunkOffset)
+{
+  chunked_t container;
+  if(!chunked_open(&container, input, insize) || offset >= container.size)
+    return -1;
+
+  size_t chunk = offset / container.chunkSize;
+  size_t start = chunk * container.chunkSize;
+  size_t len   = container.size - start;
+  if(len > container.chunkSize)
+    len = container.chunkSize;
+
+  if(outsize < len || !chunked_decompress(&container, chunk, output, len))
+    return -1;
+
+  if(chunkOffset)
+    *chunkOffset = start;
+
+  return len;
+}
@@ -0,0 +1,35 @@
+#include <3ds/util/hashmap.h>
+#include <stdlib.h>
+#include "hashmap_internal.h"
+
+static inline void
+do_clear(hashmap_slot_t            *slots,
+         uint8_t                   bits,
+         hashmap_node_destructor_t destructor)
+{
+  if(slots == NULL)
+    return;
+
+  for(size_t i = 0; destructor != NULL && i < capacity(bits); ++i)
+  {
+    if(slots[i].node != NULL && slots[i].node != TOMBSTONE)
+      (*destructor)(slots[i].node);
+  }
+
+  free(slots);
+}
+
+void
+hashmap_clear(hashmap_t                 *map,
+              hashmap_node_destructor_t destructor)
+{
+  do_clear(map->slots, map->bits, destructor);
+  do_clear(map->old_slots, map->old_bits, destructor);
+
+  map->slots     = NULL;
+  map->old_slots = NULL;
+  map->size      = 0;
+  map->migrated  = 0;
+  map->bits      = 0;
+  map->old_bits  = 0;
+}
@@ -0,0 +1,7 @@
+#include <3ds/util/hashmap.h>
+
+int
+hashmap_empty(const hashmap_t *map)
+{
+  return map->size == 0;
+}
@@ -0,0 +1,18 @@
+#include <3ds/util/hashmap.h>
+#include "hashmap_internal.h"
+
+hashmap_node_t*
+hashmap_find(const hashmap_t      *map,
+             const hashmap_node_t *node)
+{
+  if(map->size == 0)
+    return NULL;
+
+  uint32_t       hash = mix_hash(map, node);
+  hashmap_slot_t *slot = hashmap_lookup(map->slots, map->bits, hash, node, map->equal);
+
+  if(slot == NULL)
+    slot = hashmap_lookup(map->old_slots, map->old_bits, hash, node, map->equal);
+
+  return slot != NULL ? slot->node : NULL;
+}
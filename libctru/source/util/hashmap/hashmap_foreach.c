@@ -0,0 +1,34 @@
+#include <3ds/util/hashmap.h>
+#include "hashmap_internal.h"
+
+static inline size_t
+do_foreach(hashmap_slot_t         *slots,
+           uint8_t                bits,
+           hashmap_node_visitor_t visitor,
+           void                   *arg,
+           bool                   *stop)
+{
+  size_t count = 0;
+
+  for(size_t i = 0; slots != NULL && i < capacity(bits) && !*stop; ++i)
+  {
+    if(slots[i].node == NULL || slots[i].node == TOMBSTONE)
+      continue;
+
+    ++count;
+    *stop = (*visitor)(slots[i].node, arg) != 0;
+  }
+
+  return count;
+}
+
+size_t
+hashmap_foreach(const hashmap_t        *map,
+                hashmap_node_visitor_t visitor,
+                void                   *arg)
+{
+  bool stop = false;
+
+  size_t count = do_foreach(map->slots, map->bits, visitor, arg, &stop);
+  return count + do_foreach(map->old_slots, map->old_bits, visitor, arg, &stop);
+}
@@ -0,0 +1,17 @@
+#include <3ds/util/hashmap.h>
+#include "hashmap_internal.h"
+
+void
+hashmap_init(hashmap_t            *map,
+             hashmap_node_hash_t  hash,
+             hashmap_node_equal_t equal)
+{
+  map->slots     = NULL;
+  map->old_slots = NULL;
+  map->hash      = hash;
+  map->equal     = equal;
+  map->size      = 0;
+  map->migrated  = 0;
+  map->bits      = 0;
+  map->old_bits  = 0;
+}
@@ -0,0 +1,30 @@
+#include <3ds/util/hashmap.h>
+#include "hashmap_internal.h"
+
+hashmap_node_t*
+hashmap_insert(hashmap_t      *map,
+               hashmap_node_t *node)
+{
+  uint32_t       hash = mix_hash(map, node);
+  hashmap_slot_t *slot = hashmap_lookup(map->slots, map->bits, hash, node, map->equal);
+
+  if(slot == NULL)
+    slot = hashmap_lookup(map->old_slots, map->old_bits, hash, node, map->equal);
+  if(slot != NULL)
+    return slot->node;
+
+  if(map->old_slots != NULL)
+    hashmap_migrate(map, MIGRATE_STEP);
+
+  // past the load limit a failed grow still leaves room, as long as a free
+  // slot remains to end every probe
+  if(over_limit(map->size + 1, map->bits)
+  && !hashmap_grow(map) && map->size + 1 >= capacity(map->bits))
+    return NULL;
+
+  node->hash = hash;
+  hashmap_place(map->slots, map->bits, node->hash, node);
+  ++map->size;
+
+  return node;
+}
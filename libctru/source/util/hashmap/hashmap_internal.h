@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+#define MIN_BITS     4
+#define MIGRATE_STEP 8
+
+/// Marks an old slot whose node was migrated or removed, so lookups keep probing.
+#define TOMBSTONE ((hashmap_node_t*)(uintptr_t)1)
+
+static inline uint32_t
+mix_hash(const hashmap_t      *map,
+         const hashmap_node_t *node)
+{
+  // Fibonacci hashing, so the slot is taken from the best mixed bits
+  return (*map->hash)(node) * 0x9E3779B1U;
+}
+
+static inline size_t
+capacity(uint8_t bits)
+{
+  return bits ? (size_t)1 << bits : 0;
+}
+
+static inline size_t
+home_slot(uint32_t hash,
+          uint8_t  bits)
+{
+  return hash >> (32 - bits);
+}
+
+static inline size_t
+probe_distance(uint32_t hash,
+               size_t   index,
+               uint8_t  bits)
+{
+  return (index - home_slot(hash, bits)) & (capacity(bits) - 1);
+}
+
+static inline int
+over_limit(size_t  count,
+           uint8_t bits)
+{
+  // keep the load factor at or below 7/8
+  return count > capacity(bits) - capacity(bits) / 8;
+}
+
+hashmap_slot_t*
+hashmap_lookup(hashmap_slot_t       *slots,
+               uint8_t              bits,
+               uint32_t             hash,
+               const hashmap_node_t *node,
+               hashmap_node_equal_t equal);
+
+void
+hashmap_place(hashmap_slot_t *slots,
+              uint8_t        bits,
+              uint32_t       hash,
+              hashmap_node_t *node);
+
+void
+hashmap_migrate(hashmap_t *map,
+                size_t    count);
+
+bool
+hashmap_grow(hashmap_t *map);
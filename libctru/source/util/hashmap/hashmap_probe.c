@@ -0,0 +1,67 @@
+#include <3ds/util/hashmap.h>
+#include "hashmap_internal.h"
+
+hashmap_slot_t*
+hashmap_lookup(hashmap_slot_t       *slots,
+               uint8_t              bits,
+               uint32_t             hash,
+               const hashmap_node_t *node,
+               hashmap_node_equal_t equal)
+{
+  if(slots == NULL)
+    return NULL;
+
+  size_t mask = capacity(bits) - 1;
+  size_t i    = home_slot(hash, bits);
+
+  for(size_t dist = 0;; ++dist, i = (i + 1) & mask)
+  {
+    hashmap_slot_t *slot = &slots[i];
+
+    // every node is at least as far from home as the ones after it in the
+    // probe sequence, so a closer node ends the search
+    if(slot->node == NULL || probe_distance(slot->hash, i, bits) < dist)
+      return NULL;
+
+    if(slot->hash == hash && slot->node != TOMBSTONE)
+    {
+      if(equal == NULL ? slot->node == node : (*equal)(slot->node, node))
+        return slot;
+    }
+  }
+}
+
+void
+hashmap_place(hashmap_slot_t *slots,
+              uint8_t        bits,
+              uint32_t       hash,
+              hashmap_node_t *node)
+{
+  size_t mask = capacity(bits) - 1;
+  size_t i    = home_slot(hash, bits);
+
+  for(size_t dist = 0;; ++dist, i = (i + 1) & mask)
+  {
+    hashmap_slot_t *slot = &slots[i];
+
+    if(slot->node == NULL)
+    {
+      slot->hash = hash;
+      slot->node = node;
+      return;
+    }
+
+    // take the slot from a node closer to its home and carry that one on
+    size_t tmp = probe_distance(slot->hash, i, bits);
+    if(tmp < dist)
+    {
+      hashmap_slot_t save = *slot;
+      slot->hash = hash;
+      slot->node = node;
+
+      hash = save.hash;
+      node = save.node;
+      dist = tmp;
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#include <3ds/util/hashmap.h>
+#include "hashmap_internal.h"
+
+void
+hashmap_remove(hashmap_t                 *map,
+               hashmap_node_t            *node,
+               hashmap_node_destructor_t destructor)
+{
+  if(map->old_slots != NULL)
+    hashmap_migrate(map, MIGRATE_STEP);
+
+  hashmap_slot_t *slot = hashmap_lookup(map->slots, map->bits, node->hash, node, NULL);
+  if(slot != NULL)
+  {
+    size_t mask = capacity(map->bits) - 1;
+    size_t i    = slot - map->slots;
+
+    // shift the rest of the probe sequence back so no tombstone is needed
+    for(;;)
+    {
+      size_t         j    = (i + 1) & mask;
+      hashmap_slot_t *next = &map->slots[j];
+
+      if(next->node == NULL || probe_distance(next->hash, j, map->bits) == 0)
+        break;
+
+      map->slots[i] = *next;
+      i = j;
+    }
+
+    map->slots[i].node = NULL;
+  }
+  else
+  {
+    // the old table is never inserted into, so a tombstone is enough
+    slot = hashmap_lookup(map->old_slots, map->old_bits, node->hash, node, NULL);
+    slot->node = TOMBSTONE;
+  }
+
+  --map->size;
+
+  if(destructor != NULL)
+    (*destructor)(node);
+}
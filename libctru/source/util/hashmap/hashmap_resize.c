@@ -0,0 +1,86 @@
+#include <3ds/util/hashmap.h>
+#include <stdlib.h>
+#include "hashmap_internal.h"
+
+void
+hashmap_migrate(hashmap_t *map,
+                size_t    count)
+{
+  hashmap_slot_t *old  = map->old_slots;
+  size_t         total = capacity(map->old_bits);
+
+  while(count-- > 0 && map->migrated < total)
+  {
+    hashmap_slot_t *slot = &old[map->migrated++];
+    if(slot->node == NULL)
+      continue;
+
+    if(slot->node != TOMBSTONE)
+      hashmap_place(map->slots, map->bits, slot->hash, slot->node);
+
+    slot->node = TOMBSTONE;
+  }
+
+  if(map->migrated == total)
+  {
+    free(old);
+    map->old_slots = NULL;
+  }
+}
+
+static bool
+do_resize(hashmap_t *map,
+          uint8_t   bits)
+{
+  hashmap_slot_t *slots = (hashmap_slot_t*)calloc(capacity(bits), sizeof(hashmap_slot_t));
+  if(slots == NULL)
+    return false;
+
+  // growing again before the last migration finished is rare, so just finish
+  // it rather than keeping more than one old table
+  if(map->old_slots != NULL)
+    hashmap_migrate(map, SIZE_MAX);
+
+  if(map->slots != NULL)
+  {
+    map->old_slots = map->slots;
+    map->old_bits  = map->bits;
+    map->migrated  = 0;
+  }
+
+  map->slots = slots;
+  map->bits  = bits;
+  return true;
+}
+
+bool
+hashmap_grow(hashmap_t *map)
+{
+  if(map->bits == 31)
+    return false;
+
+  // with twice the slots, MIGRATE_STEP slots per operation empty the old
+  // table long before the new one fills up
+  return do_resize(map, map->bits ? map->bits + 1 : MIN_BITS);
+}
+
+bool
+hashmap_reserve(hashmap_t *map,
+                size_t    count)
+{
+  uint8_t bits = map->bits ? map->bits : MIN_BITS;
+  while(over_limit(count, bits))
+  {
+    if(bits == 31)
+      return false;
+    ++bits;
+  }
+
+  if(bits != map->bits && !do_resize(map, bits))
+    return false;
+
+  if(map->old_slots != NULL)
+    hashmap_migrate(map, SIZE_MAX);
+
+  return true;
+}
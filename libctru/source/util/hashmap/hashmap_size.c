@@ -0,0 +1,7 @@
+#include <3ds/util/hashmap.h>
+
+size_t
+hashmap_size(const hashmap_t *map)
+{
+  return map->size;
+}
@@ -0,0 +1,71 @@
+#include <3ds/util/rbtree.h>
+#include "rbtree_internal.h"
+
+static inline rbtree_node_t*
+do_bound(const rbtree_t      *tree,
+         const rbtree_node_t *node,
+         int                 upper)
+{
+  rbtree_node_t *tmp  = tree->root;
+  rbtree_node_t *save = NULL;
+
+  while(tmp != NULL)
+  {
+    int rc = (*tree->comparator)(node, tmp);
+    if(rc < 0 || (rc == 0 && !upper))
+    {
+      save = tmp;
+      tmp  = tmp->child[LEFT];
+    }
+    else
+      tmp = tmp->child[RIGHT];
+  }
+
+  return save;
+}
+
+rbtree_node_t*
+rbtree_lower_bound(const rbtree_t      *tree,
+                   const rbtree_node_t *node)
+{
+  return do_bound(tree, node, 0);
+}
+
+rbtree_node_t*
+rbtree_upper_bound(const rbtree_t      *tree,
+                   const rbtree_node_t *node)
+{
+  return do_bound(tree, node, 1);
+}
+
+size_t
+rbtree_range(const rbtree_t        *tree,
+             const rbtree_node_t   *lo,
+             const rbtree_node_t   *hi,
+             rbtree_node_visitor_t visitor,
+             void                  *arg)
+{
+  rbtree_node_t *node, *end;
+  size_t        count = 0;
+
+  // an empty range would never reach its end node
+  if(lo != NULL && hi != NULL && (*tree->comparator)(lo, hi) > 0)
+    return 0;
+
+  node = lo != NULL ? rbtree_lower_bound(tree, lo) : rbtree_min(tree);
+  end  = hi != NULL ? rbtree_upper_bound(tree, hi) : NULL;
+
+  while(node != NULL && node != end)
+  {
+    // the visitor may remove the node
+    rbtree_node_t *next = rbtree_node_next(node);
+
+    ++count;
+    if((*visitor)(node, arg))
+      break;
+
+    node = next;
+  }
+
+  return count;
+}
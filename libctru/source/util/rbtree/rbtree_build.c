@@ -0,0 +1,51 @@
+#include <3ds/util/rbtree.h>
+#include "rbtree_internal.h"
+
+static rbtree_node_t*
+do_build(rbtree_t      *tree,
+         rbtree_node_t **nodes,
+         size_t        count,
+         size_t        depth,
+         size_t        red_depth)
+{
+  if(count == 0)
+    return NULL;
+
+  size_t        mid  = count / 2;
+  rbtree_node_t *node = nodes[mid];
+
+  // halving keeps every path the same length, give or take the last level
+  node->child[LEFT]  = do_build(tree, nodes, mid, depth + 1, red_depth);
+  node->child[RIGHT] = do_build(tree, nodes + mid + 1, count - mid - 1, depth + 1, red_depth);
+
+  node->parent_color = 0;
+  if(depth == red_depth)
+    set_red(node);
+  else
+    set_black(node);
+
+  for(int i = LEFT; i <= RIGHT; ++i)
+  {
+    if(node->child[i] != NULL)
+      set_parent(node->child[i], node);
+  }
+
+  if(tree->augment != NULL)
+    (*tree->augment)(node);
+
+  return node;
+}
+
+void
+rbtree_build(rbtree_t      *tree,
+             rbtree_node_t **nodes,
+             size_t        count)
+{
+  // the last level is red unless it is full
+  size_t full = 0;
+  while((((size_t)2 << full) - 1) <= count)
+    ++full;
+
+  tree->root = do_build(tree, nodes, count, 0, full);
+  tree->size = count;
+}
@@ -6,5 +6,15 @@ rbtree_init(rbtree_t                 *tree,
 {
   tree->root       = NULL;
   tree->comparator = comparator;
+  tree->augment    = NULL;
   tree->size       = 0;
 }
+
+void
+rbtree_init_augmented(rbtree_t                 *tree,
+                      rbtree_node_comparator_t comparator,
+                      rbtree_node_augment_t    augment)
+{
+  rbtree_init(tree, comparator);
+  tree->augment = augment;
+}
@@ -1,46 +1,21 @@
 #include <3ds/util/rbtree.h>
 #include "rbtree_internal.h"
 
-static rbtree_node_t*
-do_insert(rbtree_t      *tree,
-          rbtree_node_t *node,
-          int           multi)
+static void
+do_link(rbtree_t      *tree,
+        rbtree_node_t *parent,
+        rbtree_node_t **link,
+        rbtree_node_t *node)
 {
-  rbtree_node_t *original = node;
-  rbtree_node_t **tmp     = &tree->root;
-  rbtree_node_t *parent   = NULL;
-  rbtree_node_t *save     = NULL;
-
-  while(*tmp != NULL)
-  {
-    int cmp = (*(tree->comparator))(node, *tmp);
-    parent  = *tmp;
-
-    if(cmp < 0)
-      tmp = &((*tmp)->child[LEFT]);
-    else if(cmp > 0)
-      tmp = &((*tmp)->child[RIGHT]);
-    else
-    {
-      if(!multi)
-        save = *tmp;
-
-      tmp = &((*tmp)->child[LEFT]);
-    }
-  }
-
-  if(save != NULL)
-  {
-    return save;
-  }
-
-  *tmp = node;
+  *link = node;
 
   node->child[LEFT] = node->child[RIGHT] = NULL;
   set_parent(node, parent);
 
   set_red(node);
 
+  augment_path(tree, node);
+
   while(is_red((parent = get_parent(node))))
   {
     rbtree_node_t *grandparent = get_parent(parent);
@@ -77,8 +52,73 @@ do_insert(rbtree_t      *tree,
   set_black(tree->root);
 
   tree->size += 1;
+}
+
+static rbtree_node_t*
+do_insert(rbtree_t      *tree,
+          rbtree_node_t *node,
+          int           multi)
+{
+  rbtree_node_t **tmp     = &tree->root;
+  rbtree_node_t *parent   = NULL;
+  rbtree_node_t *save     = NULL;
 
-  return original;
+  while(*tmp != NULL)
+  {
+    int cmp = (*(tree->comparator))(node, *tmp);
+    parent  = *tmp;
+
+    if(cmp < 0)
+      tmp = &((*tmp)->child[LEFT]);
+    else if(cmp > 0)
+      tmp = &((*tmp)->child[RIGHT]);
+    else
+    {
+      if(!multi)
+        save = *tmp;
+
+      tmp = &((*tmp)->child[LEFT]);
+    }
+  }
+
+  if(save != NULL)
+  {
+    return save;
+  }
+
+  do_link(tree, parent, tmp, node);
+
+  return node;
+}
+
+static rbtree_node_t*
+do_insert_hint(rbtree_t      *tree,
+               rbtree_node_t *hint,
+               rbtree_node_t *node,
+               int           multi)
+{
+  if(hint != NULL)
+  {
+    int cmp = (*(tree->comparator))(node, hint);
+    if(cmp == 0 && !multi)
+      return hint;
+
+    // the node belongs between the hint and its successor
+    rbtree_node_t *next = rbtree_node_next(hint);
+    if(cmp >= 0 && (next == NULL || (*(tree->comparator))(node, next) < 0))
+    {
+      // the successor is either above the hint, or the leftmost node of
+      // the hint's right subtree
+      if(hint->child[RIGHT] == NULL)
+        do_link(tree, hint, &hint->child[RIGHT], node);
+      else
+        do_link(tree, next, &next->child[LEFT], node);
+
+      return node;
+    }
+  }
+
+  return do_insert(tree, node, multi);
 }
 
 rbtree_node_t*
@@ -94,3 +134,19 @@ rbtree_insert_multi(rbtree_t      *tree,
 {
   do_insert(tree, node, 1);
 }
+
+rbtree_node_t*
+rbtree_insert_hint(rbtree_t      *tree,
+                   rbtree_node_t *hint,
+                   rbtree_node_t *node)
+{
+  return do_insert_hint(tree, hint, node, 0);
+}
+
+void
+rbtree_insert_multi_hint(rbtree_t      *tree,
+                         rbtree_node_t *hint,
+                         rbtree_node_t *node)
+{
+  do_insert_hint(tree, hint, node, 1);
+}
@@ -62,3 +62,17 @@ void
 rbtree_rotate(rbtree_t      *tree,
               rbtree_node_t *node,
               int           left);
+
+static inline void
+augment_path(const rbtree_t *tree,
+             rbtree_node_t  *node)
+{
+  if(tree->augment == NULL)
+    return;
+
+  while(node != NULL)
+  {
+    (*tree->augment)(node);
+    node = get_parent(node);
+  }
+}
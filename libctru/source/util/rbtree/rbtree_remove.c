@@ -128,6 +128,8 @@ rbtree_remove(rbtree_t                 *tree,
       tree->root = child;
   }
 
+  augment_path(tree, parent);
+
   if(color == BLACK)
     recolor(tree, parent, child);
 
@@ -25,4 +25,10 @@ rbtree_rotate(rbtree_t      *tree,
   else
     tree->root = tmp;
   set_parent(node, tmp);
+
+  if(tree->augment != NULL)
+  {
+    (*tree->augment)(node);
+    (*tree->augment)(tmp);
+  }
 }
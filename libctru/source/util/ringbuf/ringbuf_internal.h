@@ -0,0 +1,74 @@
+#pragma once
+
+#include <3ds/types.h>
+#include <3ds/result.h>
+#include <3ds/svc.h>
+#include <3ds/os.h>
+#include <3ds/synchronization.h>
+
+static inline uint32_t
+load_u32(const void *addr)
+{
+  return *(const volatile uint32_t*)addr;
+}
+
+static inline void
+store_u32(void     *addr,
+          uint32_t value)
+{
+  *(volatile uint32_t*)addr = value;
+}
+
+/* Waiting is a handshake on a wait word: the waiter clears it, issues a
+ * barrier and checks the ring again before sleeping while the word is 0; the
+ * other side updates the ring, issues a barrier and checks the word. One of
+ * them always sees the other, so no wake-up is lost, and the fast path only
+ * pays for a barrier and a load.
+ */
+
+static inline void
+wake(int32_t *wait,
+     int32_t count)
+{
+  __dmb();
+  if(load_u32(wait) == 0)
+  {
+    store_u32(wait, 1);
+    syncArbitrateAddress(wait, ARBITRATION_SIGNAL, count);
+  }
+}
+
+static inline void
+arm_wait(int32_t *wait)
+{
+  store_u32(wait, 0);
+  __dmb();
+}
+
+/* A wait may be woken up several times before its condition holds, so the
+ * timeout runs from the tick at which the wait started rather than from the
+ * last wake-up.
+ */
+
+static inline uint64_t
+wait_start(int64_t timeout_ns)
+{
+  return timeout_ns < 0 ? 0 : svcGetSystemTick();
+}
+
+static inline int
+do_wait(int32_t  *wait,
+        uint64_t start,
+        int64_t  timeout_ns)
+{
+  if(timeout_ns < 0)
+  {
+    syncArbitrateAddress(wait, ARBITRATION_WAIT_IF_LESS_THAN, 1);
+    return 0;
+  }
+
+  int64_t elapsed = (int64_t)((svcGetSystemTick() - start) * (1000.0 / CPU_TICKS_PER_USEC));
+  Result  rc      = syncArbitrateAddressWithTimeout(wait, ARBITRATION_WAIT_IF_LESS_THAN_TIMEOUT, 1,
+                                                    elapsed < timeout_ns ? timeout_ns - elapsed : 0);
+  return R_DESCRIPTION(rc) == RD_TIMEOUT;
+}
@@ -0,0 +1,149 @@
+#include <3ds/util/ringbuf.h>
+#include <string.h>
+#include "ringbuf_internal.h"
+
+/* Every slot starts with a sequence number. A slot at position pos is free
+ * for the producer that claims pos when its sequence is pos, and holds that
+ * producer's element once its sequence is pos + 1. The consumer frees it for
+ * the next lap by setting it to pos + capacity.
+ */
+
+static inline uint8_t*
+get_slot(const ringbuf_mpsc_t *rb,
+         uint32_t             pos)
+{
+  return rb->slots + (pos & rb->mask) * rb->slot_size;
+}
+
+void
+ringbuf_mpsc_init(ringbuf_mpsc_t *rb,
+                  void           *buffer,
+                  size_t         elem_size,
+                  uint32_t       capacity)
+{
+  rb->head       = 0;
+  rb->read_wait  = 1;
+  rb->tail       = 0;
+  rb->write_wait = 1;
+  rb->slots      = (uint8_t*)buffer;
+  rb->elem_size  = elem_size;
+  rb->slot_size  = RINGBUF_MPSC_SLOT_SIZE(elem_size);
+  rb->mask       = capacity - 1;
+
+  for(uint32_t i = 0; i < capacity; ++i)
+    store_u32(get_slot(rb, i), i);
+}
+
+bool
+ringbuf_mpsc_push(ringbuf_mpsc_t *rb,
+                  const void     *elem)
+{
+  uint32_t pos;
+  uint8_t  *slot;
+
+  for(;;)
+  {
+    pos  = __ldrex(&rb->tail);
+    slot = get_slot(rb, pos);
+
+    int32_t diff = (int32_t)(load_u32(slot) - pos);
+    if(diff == 0)
+    {
+      if(!__strex(&rb->tail, pos + 1))
+        break;
+    }
+    else
+    {
+      __clrex();
+
+      // the consumer has not freed the slot from the last lap yet
+      if(diff < 0)
+        return false;
+    }
+  }
+
+  // the consumer must be done reading the slot before it is reused
+  __dmb();
+  memcpy(slot + sizeof(uint32_t), elem, rb->elem_size);
+
+  __dmb();
+  store_u32(slot, pos + 1);
+
+  wake(&rb->read_wait, 1);
+  return true;
+}
+
+static inline bool
+is_readable(const ringbuf_mpsc_t *rb)
+{
+  return load_u32(get_slot(rb, rb->head)) == rb->head + 1;
+}
+
+static inline bool
+is_writable(const ringbuf_mpsc_t *rb)
+{
+  uint32_t pos = load_u32(&rb->tail);
+  return (int32_t)(load_u32(get_slot(rb, pos)) - pos) >= 0;
+}
+
+bool
+ringbuf_mpsc_pop(ringbuf_mpsc_t *rb,
+                 void           *elem)
+{
+  uint32_t pos  = rb->head;
+  uint8_t  *slot = get_slot(rb, pos);
+
+  if(load_u32(slot) != pos + 1)
+    return false;
+
+  // the element must be read after the sequence that published it
+  __dmb();
+  memcpy(elem, slot + sizeof(uint32_t), rb->elem_size);
+
+  __dmb();
+  store_u32(slot, pos + rb->mask + 1);
+  rb->head = pos + 1;
+
+  wake(&rb->write_wait, ARBITRATION_SIGNAL_ALL);
+  return true;
+}
+
+int
+ringbuf_mpsc_wait_readable(ringbuf_mpsc_t *rb,
+                           int64_t        timeout_ns)
+{
+  uint64_t start = wait_start(timeout_ns);
+
+  for(;;)
+  {
+    if(is_readable(rb))
+      return 0;
+
+    arm_wait(&rb->read_wait);
+    if(is_readable(rb))
+      return 0;
+
+    if(do_wait(&rb->read_wait, start, timeout_ns))
+      return !is_readable(rb);
+  }
+}
+
+int
+ringbuf_mpsc_wait_writable(ringbuf_mpsc_t *rb,
+                           int64_t        timeout_ns)
+{
+  uint64_t start = wait_start(timeout_ns);
+
+  for(;;)
+  {
+    if(is_writable(rb))
+      return 0;
+
+    arm_wait(&rb->write_wait);
+    if(is_writable(rb))
+      return 0;
+
+    if(do_wait(&rb->write_wait, start, timeout_ns))
+      return !is_writable(rb);
+  }
+}
@@ -0,0 +1,168 @@
+#include <3ds/util/ringbuf.h>
+#include <string.h>
+#include "ringbuf_internal.h"
+
+void
+ringbuf_init(ringbuf_t *rb,
+             void      *buffer,
+             size_t    elem_size,
+             uint32_t  capacity)
+{
+  rb->tail       = 0;
+  rb->head_cache = 0;
+  rb->read_wait  = 1;
+  rb->head       = 0;
+  rb->tail_cache = 0;
+  rb->write_wait = 1;
+  rb->data       = (uint8_t*)buffer;
+  rb->elem_size  = elem_size;
+  rb->mask       = capacity - 1;
+}
+
+size_t
+ringbuf_readable(const ringbuf_t *rb)
+{
+  return load_u32(&rb->head) - load_u32(&rb->tail);
+}
+
+size_t
+ringbuf_writable(const ringbuf_t *rb)
+{
+  return rb->mask + 1 - (load_u32(&rb->head) - load_u32(&rb->tail));
+}
+
+/* Copies count elements between a linear buffer and the ring at a position,
+ * wrapping around the end of the ring.
+ */
+static inline void
+copy_ring(const ringbuf_t *rb,
+          uint32_t        pos,
+          void            *buf,
+          size_t          count,
+          bool            to_ring)
+{
+  size_t  index = pos & rb->mask;
+  size_t  first = rb->mask + 1 - index;
+  uint8_t *ring = rb->data + index * rb->elem_size;
+
+  if(first > count)
+    first = count;
+
+  if(to_ring)
+  {
+    memcpy(ring, buf, first * rb->elem_size);
+    memcpy(rb->data, (uint8_t*)buf + first * rb->elem_size, (count - first) * rb->elem_size);
+  }
+  else
+  {
+    memcpy(buf, ring, first * rb->elem_size);
+    memcpy((uint8_t*)buf + first * rb->elem_size, rb->data, (count - first) * rb->elem_size);
+  }
+}
+
+size_t
+ringbuf_write(ringbuf_t  *rb,
+              const void *src,
+              size_t     count)
+{
+  uint32_t head = rb->head;
+  size_t   room = rb->mask + 1 - (head - rb->tail_cache);
+
+  // only touch the consumer's cache line when the last known room runs out
+  if(room < count)
+  {
+    rb->tail_cache = load_u32(&rb->tail);
+    room = rb->mask + 1 - (head - rb->tail_cache);
+
+    // the consumer must be done reading the slots before they are reused
+    __dmb();
+  }
+
+  if(count > room)
+    count = room;
+  if(count == 0)
+    return 0;
+
+  copy_ring(rb, head, (void*)src, count, true);
+
+  // publish the elements before the position
+  __dmb();
+  store_u32(&rb->head, head + count);
+
+  wake(&rb->read_wait, 1);
+  return count;
+}
+
+size_t
+ringbuf_read(ringbuf_t *rb,
+             void      *dst,
+             size_t    count)
+{
+  uint32_t tail  = rb->tail;
+  size_t   avail = rb->head_cache - tail;
+
+  if(avail < count)
+  {
+    rb->head_cache = load_u32(&rb->head);
+    avail = rb->head_cache - tail;
+
+    // the elements must be read after the position that published them
+    __dmb();
+  }
+
+  if(count > avail)
+    count = avail;
+  if(count == 0)
+    return 0;
+
+  copy_ring(rb, tail, dst, count, false);
+
+  // finish reading the slots before handing them back
+  __dmb();
+  store_u32(&rb->tail, tail + count);
+
+  wake(&rb->write_wait, 1);
+  return count;
+}
+
+int
+ringbuf_wait_readable(ringbuf_t *rb,
+                      size_t    count,
+                      int64_t   timeout_ns)
+{
+  uint64_t start = wait_start(timeout_ns);
+
+  for(;;)
+  {
+    if(ringbuf_readable(rb) >= count)
+      return 0;
+
+    arm_wait(&rb->read_wait);
+    if(ringbuf_readable(rb) >= count)
+      return 0;
+
+    if(do_wait(&rb->read_wait, start, timeout_ns))
+      return ringbuf_readable(rb) < count;
+  }
+}
+
+int
+ringbuf_wait_writable(ringbuf_t *rb,
+                      size_t    count,
+                      int64_t   timeout_ns)
+{
+  uint64_t start = wait_start(timeout_ns);
+
+  for(;;)
+  {
+    if(ringbuf_writable(rb) >= count)
+      return 0;
+
+    arm_wait(&rb->write_wait);
+    if(ringbuf_writable(rb) >= count)
+      return 0;
+
+    if(do_wait(&rb->write_wait, start, timeout_ns))
+      return ringbuf_writable(rb) < count;
+  }
+}
@@ -1,5 +1,6 @@
 #include "3ds/types.h"
 #include "3ds/util/utf.h"
+#include "utf_internal.h"
 
 ssize_t
 utf16_to_utf8(uint8_t        *out,
@@ -8,11 +9,26 @@ utf16_to_utf8(uint8_t        *out,
 {
   ssize_t  rc = 0;
   ssize_t  units;
-  uint32_t code;
+  uint32_t code = 0;
   uint8_t  encoded[4];
 
   do
   {
+    /* ASCII fast path, two code units per word, tried after ASCII */
+    while(code < 0x80 && is_aligned(in) && is_ascii16(load_word(in))
+       && fits_whole(out, rc, len, 2) && SSIZE_MAX - 2 >= rc)
+    {
+      if(out != NULL && (size_t)rc < len)
+      {
+        out[0] = in[0];
+        out[1] = in[1];
+        out += 2;
+      }
+
+      in += 2;
+      rc += 2;
+    }
+
     units = decode_utf16(&code, in);
     if(units == -1)
       return -1;
@@ -12,6 +12,17 @@ utf32_to_utf16(uint16_t       *out,
 
   while(*in > 0)
   {
+    /* fast path for the basic multilingual plane */
+    if(*in < 0x10000 && SSIZE_MAX - 1 >= rc)
+    {
+      if(out != NULL && (size_t)rc < len)
+        *out++ = *in;
+
+      ++in;
+      ++rc;
+      continue;
+    }
+
     units = encode_utf16(encoded, *in++);
     if(units == -1)
       return -1;
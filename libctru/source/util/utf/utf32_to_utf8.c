@@ -12,6 +12,17 @@ utf32_to_utf8(uint8_t        *out,
 
   while(*in > 0)
   {
+    /* ASCII fast path */
+    if(*in < 0x80 && SSIZE_MAX - 1 >= rc)
+    {
+      if(out != NULL && (size_t)rc < len)
+        *out++ = *in;
+
+      ++in;
+      ++rc;
+      continue;
+    }
+
     units = encode_utf8(encoded, *in++);
     if(units == -1)
       return -1;
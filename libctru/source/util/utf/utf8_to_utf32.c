@@ -1,5 +1,6 @@
 #include "3ds/types.h"
 #include "3ds/util/utf.h"
+#include "utf_internal.h"
 
 ssize_t
 utf8_to_utf32(uint32_t      *out,
@@ -8,10 +9,27 @@ utf8_to_utf32(uint32_t      *out,
 {
   ssize_t  rc = 0;
   ssize_t  units;
-  uint32_t code;
+  uint32_t code = 0;
 
   do
   {
+    /* ASCII fast path, four code units per word, tried after ASCII */
+    while(code < 0x80 && is_aligned(in) && is_ascii8(load_word(in))
+       && fits_whole(out, rc, len, 4) && SSIZE_MAX - 4 >= rc)
+    {
+      if(out != NULL && (size_t)rc < len)
+      {
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+        out[3] = in[3];
+        out += 4;
+      }
+
+      in += 4;
+      rc += 4;
+    }
+
     units = decode_utf8(&code, in);
     if(units == -1)
       return -1;
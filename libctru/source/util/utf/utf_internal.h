@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* The ASCII fast paths load whole aligned words. The word holding the null
+ * terminator may extend past the end of the input, but an aligned load never
+ * crosses into another page.
+ */
+
+static inline bool
+is_aligned(const void *in)
+{
+  return ((uintptr_t)in & 3) == 0;
+}
+
+static inline uint32_t
+load_word(const void *in)
+{
+  uint32_t word;
+  memcpy(&word, __builtin_assume_aligned(in, 4), sizeof(word));
+  return word;
+}
+
+/* Whether all four bytes of a word are ASCII and none of them is the null
+ * terminator; a zero byte borrows into its top bit when subtracting.
+ */
+static inline bool
+is_ascii8(uint32_t word)
+{
+  return ((word | (word - 0x01010101)) & 0x80808080) == 0;
+}
+
+/* Whether both UTF-16 code units of a word are ASCII and non-null */
+static inline bool
+is_ascii16(uint32_t word)
+{
+  return ((word | (word - 0x00010001)) & 0xFF80FF80) == 0;
+}
+
+/* Whether a run of \a units single-unit codepoints is either written whole
+ * or not at all, so it can take a fast path without splitting the run.
+ */
+static inline bool
+fits_whole(const void *out,
+           ssize_t    rc,
+           size_t     len,
+           size_t     units)
+{
+  return out == NULL || (size_t)rc >= len || len - rc >= units;
+}